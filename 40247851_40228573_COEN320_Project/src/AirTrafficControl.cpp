@@ -4,9 +4,19 @@
 #include <sstream>
 #include <string>
 #include <thread>
+#include <queue>
+#include <functional>
+#include <algorithm>
+#include <memory>
+#include <cstring>
+#include <cerrno>
+#include "ATCTimer.h"
 
-AirTrafficControl::AirTrafficControl() {
-    // Constructor remains empty
+// Simulated time between two aircraft pool reports
+const uint64_t POOL_REPORT_INTERVAL_MS = 60000;
+
+AirTrafficControl::AirTrafficControl(PositionTable* table, uint32_t step, SimulationModel simulationModel, unsigned workers, VirtualClock* clock)
+    : stopCommands(false), positionTable(table), stepMs(step), model(simulationModel), simulationWorkers(workers), virtualClock(clock) {
 }
 
 AirTrafficControl::~AirTrafficControl() {
@@ -42,29 +52,173 @@ void AirTrafficControl::readPlanesFromFile(const std::string& fileName) {
 }
 
 void AirTrafficControl::startPlanes() {
-    // For each plane data, create an Aircraft instance and start its thread
-    for (const auto& data : planeData) {
-        // Print the values when creating the Aircraft instance (optional)
-        std::cout << "Creating Aircraft " << data.id << ": "
-                  << "Pos(" << data.posX << ", " << data.posY << ", " << data.posZ << ") "
-                  << "Speed(" << data.speedX << ", " << data.speedY << ", " << data.speedZ << ") "
-                  << "ArrivalTime(" << data.arrivaTime << ")\n";
-
-        // Dynamically allocate Aircraft instance and store the pointer in planes vector
-        Aircraft* plane = new Aircraft(data.id, data.posX, data.posY, data.posZ,
-                                       data.speedX, data.speedY, data.speedZ, data.arrivaTime);
-        planes.push_back(plane);  // Store the pointer in the vector
+    // Batched: one engine steps every aircraft, and returns once all have left
+    if (model == SIMULATION_BATCHED && positionTable) {
+        SimulationEngine engine(*positionTable, stepMs, simulationWorkers, virtualClock);
+        for (const auto& data : planeData) {
+            engine.addAircraft(data.id, data.posX, data.posY, data.posZ,
+                               data.speedX, data.speedY, data.speedZ, data.arrivaTime);
+        }
+        std::cout << "Simulating " << planeData.size() << " aircraft in batched mode\n";
+        engine.run();
+        allPlanesFinished = true;
+        std::cout << "All aircraft have finished their tasks and are no longer active.\n";
+        return;
+    }
+
+    // Thread per aircraft: flights wait in a min-heap keyed by arrival time and each
+    // Aircraft (and its thread) is only created once it is due, in a slot of the pool, and
+    // released when its thread ends for the next arrival to reuse. Threads and memory follow
+    // the live traffic, not the whole scenario. Equal arrival times keep file order.
+    typedef std::pair<uint64_t, size_t> ScheduledArrival;  // (arrival in ms, index in planeData)
+    std::priority_queue<ScheduledArrival, std::vector<ScheduledArrival>, std::greater<ScheduledArrival>> pending;
+    for (size_t i = 0; i < planeData.size(); ++i) {
+        pending.emplace(static_cast<uint64_t>(std::max(planeData[i].arrivaTime, 0)) * 1000, i);
+    }
+
+    // Commands go to the aircraft's inbox as they arrive, never waiting for the aircraft
+    name_attach_t* commandChannel = name_attach(NULL, SIMULATION_CHANNEL_NAME, 0);
+    std::thread commandListener;
+    if (commandChannel == NULL) {
+        std::cerr << "Failed to create command channel, commands only reach aircraft on their own channel" << std::endl;
+    } else {
+        // The listener gets the chid rather than the channel, which name_detach frees under it
+        commandListener = std::thread(&AirTrafficControl::listenCommands, this, commandChannel->chid);
+    }
+
+    // With the virtual clock the scheduler is one more participant of the aircraft stage, and
+    // creates each aircraft during its own turn so the aircraft joins that same tick
+    std::unique_ptr<ClockParticipant> participant;
+    std::unique_ptr<ATCTimer> timer;
+    if (virtualClock) {
+        participant.reset(new ClockParticipant(*virtualClock, CLOCK_STAGE_AIRCRAFT));
+    } else {
+        timer.reset(new ATCTimer(stepMs / 1000, stepMs % 1000));
     }
+    uint64_t currentTime = 0;  // Elapsed time in ms, as the aircraft count it
+    uint64_t nextPoolReport = POOL_REPORT_INTERVAL_MS;
+    bool stopped = participant && !participant->waitTurn();
+    while (!stopped && (!pending.empty() || !planes.empty())) {
+        while (!pending.empty() && pending.top().first <= currentTime) {
+            const PlaneData& data = planeData[pending.top().second];
+            pending.pop();
 
-    // Join all aircraft threads
-    for (Aircraft* Plane : planes) {
-        if (pthread_join(Plane->thread_id, nullptr) != 0) { // join with each plane's thread
-            std::cerr << "Error: pthread_join failed for Aircraft " << Plane->getID() << std::endl;
-            exit(1);
+            // Print the values when creating the Aircraft instance (optional)
+            std::cout << "Creating Aircraft " << data.id << ": "
+                      << "Pos(" << data.posX << ", " << data.posY << ", " << data.posZ << ") "
+                      << "Speed(" << data.speedX << ", " << data.speedY << ", " << data.speedZ << ") "
+                      << "ArrivalTime(" << data.arrivaTime << ")\n";
+
+            // Created at its arrival time, so its thread enters the airspace right away
+            Aircraft* plane = aircraftPool.create(data.id, data.posX, data.posY, data.posZ,
+                                                  data.speedX, data.speedY, data.speedZ, data.arrivaTime, positionTable, stepMs, currentTime, virtualClock);
+            planes.push_back(plane);  // Store the pointer in the vector
+            std::lock_guard<std::mutex> lock(planesByIdMutex);
+            planesById[data.id] = plane;
+        }
+
+        // Join the aircraft whose thread has ended
+        for (size_t i = 0; i < planes.size();) {
+            if (!planes[i]->finished.load()) {
+                ++i;
+                continue;
+            }
+            if (pthread_join(planes[i]->thread_id, nullptr) != 0) { // join with the plane's thread
+                std::cerr << "Error: pthread_join failed for Aircraft " << planes[i]->getID() << std::endl;
+                exit(1);
+            }
+            {
+                std::lock_guard<std::mutex> lock(planesByIdMutex);
+                auto byId = planesById.find(planes[i]->getID());
+                if (byId != planesById.end() && byId->second == planes[i]) {
+                    planesById.erase(byId);
+                }
+            }
+            aircraftPool.release(planes[i]);
+            planes[i] = planes.back();
+            planes.pop_back();
+        }
+
+        if (currentTime >= nextPoolReport) {
+            reportPool();
+            nextPoolReport += POOL_REPORT_INTERVAL_MS;
+        }
+
+        if (participant) {
+            participant->complete();
+            stopped = !participant->waitTurn();
+        } else {
+            timer->waitTimer();
         }
+        currentTime += stepMs;
+    }
+    participant.reset();
+
+    // Only left when the virtual clock stopped; the aircraft still flying see it too and end
+    {
+        std::lock_guard<std::mutex> lock(planesByIdMutex);
+        planesById.clear();
+    }
+    for (Aircraft* plane : planes) {
+        pthread_join(plane->thread_id, nullptr);
+        aircraftPool.release(plane);
+    }
+    planes.clear();
+
+    if (commandChannel) {
+        stopCommands.store(true);
+        name_detach(commandChannel, 0);
+    }
+    if (commandListener.joinable()) {
+        commandListener.join();
     }
     allPlanesFinished = true;  // Set the flag after all threads are joined
     std::cout << "All aircraft have finished their tasks and are no longer active.\n";
+    reportPool();
+}
+
+void AirTrafficControl::reportPool() const {
+    std::cout << "Aircraft pool: " << aircraftPool.getLiveCount() << " live, high-water mark "
+              << aircraftPool.getHighWaterMark() << ", " << aircraftPool.getSlotCount() << " slots, "
+              << aircraftPool.getReuseCount() << " reused" << std::endl;
+}
+
+void AirTrafficControl::listenCommands(int chid) {
+    while (!stopCommands.load()) {
+        Message_inter_process msg;
+        memset(&msg, 0, sizeof(msg));
+        int rcvid = MsgReceive(chid, &msg, sizeof(msg), NULL);
+        if (rcvid == -1) {
+            continue;
+        }
+        // Skip pulses
+        if (rcvid == 0) {
+            continue;
+        }
+
+        // Held under the lock so the scheduler cannot release the aircraft meanwhile
+        int error = 0;
+        {
+            std::lock_guard<std::mutex> lock(planesByIdMutex);
+            auto plane = planesById.find(msg.planeID);
+            if (plane == planesById.end()) {
+                error = ESRCH;
+            } else if (!plane->second->postCommand(msg)) {
+                error = EAGAIN;
+            }
+        }
+        if (error == ESRCH) {
+            std::cerr << "Aircraft " << msg.planeID << " is not flying, command dropped\n";
+        } else if (error == EAGAIN) {
+            std::cerr << "Aircraft " << msg.planeID << " has too many commands queued, command dropped\n";
+        }
+        // The sender's MsgSend fails with the errno on a rejection
+        if (error) {
+            MsgError(rcvid, error);
+        } else {
+            MsgReply(rcvid, 0, NULL, 0);
+        }
+    }
 }
 
 bool AirTrafficControl::areAllPlanesFinished() const {
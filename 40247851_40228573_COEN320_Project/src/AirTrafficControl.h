@@ -2,9 +2,16 @@
 #define AIRTRAFFICCONTROL_H
 
 #include "Aircraft.h"
+#include "AircraftPool.h"
+#include "PositionTable.h"
+#include "SimulationEngine.h"
+#include "VirtualClock.h"
 #include <vector>
 #include <thread>
 #include <string>
+#include <mutex>
+#include <atomic>
+#include <unordered_map>
 
 // Struct to hold the plane data temporarily
 struct PlaneData {
@@ -16,20 +23,41 @@ struct PlaneData {
 
 class AirTrafficControl {
 public:
-    AirTrafficControl();
+    // positionTable is handed to every aircraft; nullptr keeps them in pull mode.
+    // stepMs is the aircraft simulation step.
+    // The batched model needs a positionTable; simulationWorkers are its step threads.
+    // A virtualClock paces the scheduler and every aircraft instead of their timers.
+    AirTrafficControl(PositionTable* positionTable = nullptr, uint32_t stepMs = 1000,
+                      SimulationModel model = SIMULATION_THREAD_PER_AIRCRAFT, unsigned simulationWorkers = 1,
+                      VirtualClock* virtualClock = nullptr);
     ~AirTrafficControl();
 
     // Reads the file and creates aircraft instances
     void readPlanesFromFile(const std::string& fileName);
 
-    // Starts all planes (i.e., creates and joins their threads)
+    // Starts all planes (i.e., creates and joins their threads, or runs the batched engine)
     void startPlanes();
     bool areAllPlanesFinished() const;
 
 private:
-    std::vector<Aircraft*> planes;  // Stores all aircraft objects
+    // Thread per aircraft: queues operator commands sent to SIMULATION_CHANNEL_NAME in the
+    // inbox of the aircraft they are for
+    void listenCommands(int chid);
+
+    void reportPool() const;
+
+    AircraftPool aircraftPool;      // Holds the aircraft below; slots are recycled as they leave
+    std::vector<Aircraft*> planes;  // Aircraft in flight; created when due, released once their thread ends
+    std::unordered_map<int, Aircraft*> planesById;  // Same aircraft, for the command listener
+    std::mutex planesByIdMutex;
+    std::atomic<bool> stopCommands;
     std::vector<PlaneData> planeData;  // Stores the plane data
     bool allPlanesFinished = false;  // Flag to indicate all planes are done
+    PositionTable* positionTable;
+    uint32_t stepMs;
+    SimulationModel model;
+    unsigned simulationWorkers;
+    VirtualClock* virtualClock;  // nullptr in real time
 };
 
 #endif // AIRTRAFFICCONTROL_H
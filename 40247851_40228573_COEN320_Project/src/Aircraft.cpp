@@ -2,25 +2,43 @@
 #include <iomanip>
 #include <memory>
 #include <pthread.h>
+#include <algorithm>
 #include "Aircraft.h"
-#include "ATCTimer.h"
+#include <errno.h>
+#include <time.h>
 
 
 //Coen320_Lab (Task0): Radar Channel name should contain your group name
 #define Radar "AH_40247851_40228573_Radar" //attach point for AirTrafficControl
 /*#define Display_ID "display" //attach point for AirTrafficControl // It is for future use*/
 
+namespace {
+
+uint64_t monotonicNs() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<uint64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+}
+
+}
+
 void* updatePositionThread(void* arg) {
     Aircraft* aircraft = static_cast<Aircraft*>(arg);
-    return reinterpret_cast<void*>(aircraft->updatePosition());
+    int result = aircraft->updatePosition();
+    aircraft->finished.store(true);
+    return reinterpret_cast<void*>(result);
 }
 
 // Constructor definition
-Aircraft::Aircraft(int id, double x, double y, double z, double sx, double sy, double sz, int t)
-    : id(id), posX(x), posY(y), posZ(z), speedX(sx), speedY(sy), speedZ(sz), arrivalTime(t), inAirspace(true) {
+Aircraft::Aircraft(int id, double x, double y, double z, double sx, double sy, double sz, int t, PositionTable* table, uint32_t step, uint64_t start, VirtualClock* virtualClock)
+    : finished(false), id(id), posX(x), posY(y), posZ(z), speedX(sx), speedY(sy), speedZ(sz), arrivalTime(t), stepMs(std::max(step, 1u)), startMs(start), inAirspace(true), positionTable(table), positionSlot(-1), maneuverCount(0) {
 	message_id = -1;
 	Radar_id = -1;
-	airspace = {0, 100000, 0, 100000, 15000, 40000};
+	airspace = DEFAULT_AIRSPACE;
+	// Joined here rather than on the thread, so the aircraft already takes part in the tick it is created in
+	if (virtualClock) {
+		clockParticipant.reset(new ClockParticipant(*virtualClock, CLOCK_STAGE_AIRCRAFT));
+	}
 	// Coen320_lab3(Task1): You need to create a thread worker
 	// Worker function: updatePositionThread
 	// Worker function parameters: (void*)this
@@ -54,21 +72,71 @@ void Aircraft::changeHeading(double Vx, double Vy, double Vz){
 	if (Vx != 0) speedX = Vx;
 	if (Vy != 0) speedY = Vy;
 	if (Vz != 0) speedZ = Vz;
+	maneuverCount++;
 	std::cout << "Aircraft " << id << " heading changed to: VX=" << speedX
 	          << " VY=" << speedY << " VZ=" << speedZ << "\n";
 }
 
 
 int Aircraft::updatePosition() {
-    ATCTimer timer(1, 0);
-    int currentTime = 0;  // Variable to track current time
+    // With the virtual clock a step ends with completing the tick. In real time steps fall due
+    // every stepMs on an absolute schedule, and the channel is served in between, so neither
+    // the Radar nor the operator can hold a step back.
+    // The participant leaves the clock on every return below.
+    std::unique_ptr<ClockParticipant> participant = std::move(clockParticipant);
+    if (participant && !participant->waitTurn()) {
+        return 0;
+    }
+    uint64_t nextStepNs = monotonicNs();
+    name_attach_t* Plane_channel = NULL;
+    // False once the virtual clock has stopped
+    auto waitStep = [&]() {
+        if (participant) {
+            if (Plane_channel) {
+                serveChannel(Plane_channel, 0);
+            }
+            participant->complete();
+            return participant->waitTurn();
+        }
+        nextStepNs += static_cast<uint64_t>(stepMs) * 1000000;
+        if (Plane_channel) {
+            serveChannel(Plane_channel, nextStepNs);
+        } else {
+            struct timespec due;
+            due.tv_sec = nextStepNs / 1000000000;
+            due.tv_nsec = nextStepNs % 1000000000;
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL) == EINTR) {
+            }
+        }
+        return true;
+    };
+    const double dt = stepMs / 1000.0;  // Step length in seconds
+    uint64_t currentTime = startMs;  // Elapsed time in ms
 
     // Wait until the arrival time has passed
-    while (currentTime < arrivalTime) {
-        timer.waitTimer();  // Wait for 1 second
-        ++currentTime;
+    while (currentTime < static_cast<uint64_t>(arrivalTime) * 1000) {
+        if (!waitStep()) {  // Wait for one step
+            return 0;
+        }
+        currentTime += stepMs;
+    }
+
+    //********SEND UPDATE POSITION TO RADAR**************
+    //Coen320_Lab (Task0): Create channel to be reachable by radar that wants to poll the Airplane
+    //To chose the polling channel concatenate your group name with the plane id
+    //Note: It is critical to not interfere other groups
+    //The channel is attached before ENTER_AIRSPACE so the Radar can cache its connection on arrival
+    std::string id_str = "AH_40247851_40228573_"+std::to_string(id);  // Convert integer id to string
+    const char* ID = id_str.c_str();         // Convert string to const char*
+    Plane_channel = name_attach(NULL, ID, 0); // For server
+
+    if (Plane_channel == NULL) {
+        std::cerr << "Could not attach plane ID: " << ID << " to channel\n";
+        return EXIT_FAILURE;
     }
 
+    std::cout << "Aircraft " << id << " channel created and listening\n";
+
     //********SEND ENTER AIRSPACE TO RADAR**************
     //Coen320_Lab3(Task5): We are using message passing. Learn how to open a channel with Radar module
     // Open channel with radar and verify if the channel opened successfully
@@ -76,9 +144,18 @@ int Aircraft::updatePosition() {
 
     if ((Radar_id = name_open(Radar, 0)) == -1) {
 		perror("Error occurred while creating the channel with Radar");
+		name_detach(Plane_channel, 0);
 		return EXIT_FAILURE;
 	}
 
+    // Push mode: claim our slot before announcing ourselves so the first sweep already sees us
+    if (positionTable) {
+        positionSlot = positionTable->acquireSlot(currentState());
+        if (positionSlot == -1) {
+            std::cerr << "Aircraft " << id << ": position table full\n";
+        }
+    }
+
     //Coen320_Lab3(Task6): Once the arrival time is reached, send the ENTER_AIRSPACE message
     //Read and learn how we create a message
     Message enterAirspaceMessage = createEnterAirspaceMessage(id);
@@ -96,30 +173,19 @@ int Aircraft::updatePosition() {
 
     if (MsgSend(Radar_id, &enterAirspaceMessage, sizeof(enterAirspaceMessage),0,0) == -1) {
             std::cout << "Failed to send enter message to Radar!\n";
+            name_detach(Plane_channel, 0);
             return EXIT_FAILURE;
 	}
 
-    //********SEND UPDATE POSITION TO RADAR**************
-    //Coen320_Lab (Task0): Create channel to be reachable by radar that wants to poll the Airplane
-    //To chose the polling channel concatenate your group name with the plane id
-    //Note: It is critical to not interfere other groups
-    std::string id_str = "AH_40247851_40228573_"+std::to_string(id);  // Convert integer id to string
-    const char* ID = id_str.c_str();         // Convert string to const char*
-    name_attach_t* Plane_channel = name_attach(NULL, ID, 0); // For server
-
-    if (Plane_channel == NULL) {
-        std::cerr << "Could not attach plane ID: " << ID << " to channel\n";
-        return EXIT_FAILURE;
-    }
-
-    std::cout << "Aircraft " << id << " channel created and listening\n";
-
     // Start the position update loop
     while (true) {
+        // Commands queued since the last step take effect before it moves
+        applyCommands();
+
         // Update position based on velocity
-        posX += speedX;
-        posY += speedY;
-        posZ += speedZ;
+        posX += speedX * dt;
+        posY += speedY * dt;
+        posZ += speedZ * dt;
 
         // Debug: Print the new position choose which plane by changing the id
        /* if (id == 2){
@@ -131,6 +197,10 @@ int Aircraft::updatePosition() {
             posZ < airspace.lower_z_boundary || posZ > airspace.upper_z_boundary) {
             // Send exit airspace message and exit loop if out of bounds
             std::cout << "Aircraft " << id << " exiting airspace\n";
+            if (positionTable) {
+                positionTable->releaseSlot(positionSlot);
+                positionSlot = -1;
+            }
             Message exitAirspaceMessage = createExitAirspaceMessage(id);
             if (MsgSend(Radar_id, &exitAirspaceMessage, sizeof(exitAirspaceMessage), 0, 0) == -1) {
                 std::cout << "Failed to send exit message to Radar!\n";
@@ -139,112 +209,153 @@ int Aircraft::updatePosition() {
             break;  // Exit the loop if out of bounds
         }
 
-        // Check for incoming position update requests from Radar
-        char buffer[sizeof(Message_inter_process)];  // Buffer to handle largest message size
-        int rcvid = MsgReceive(Plane_channel->chid, buffer, sizeof(buffer), NULL);
-
-        if (rcvid != -1) {
-            // Determine message type by checking the MessageType field and recast
-            Message* baseMsg = reinterpret_cast<Message*>(buffer);
-
-            MessageType msgType = baseMsg->type;
-            int typeValue = static_cast<int>(msgType);
-
-            // Valid MessageType enum values are 0-10 so anyhting else is an error
-            // If we get  data (like 223) it's from Radar which doesn't properly connect it means
-            // REQUEST_POSITION (3) is always from Radar
-            // Types 4-10 are from Communications System and are our operator commands we input
-            bool isValidType = (typeValue >= 0 && typeValue <= 10);
-            bool isInterProcess = isValidType && (msgType != MessageType::REQUEST_POSITION);
-
-
-            if (isInterProcess){  // if its from Communications System
-            	// Recast it to be of type Message_inter_process
-            	Message_inter_process* receivedMsg = reinterpret_cast<Message_inter_process*>(buffer);
-
-            	// Debug
-            	std::cout << "Aircraft " << id << " received inter-process message, type: "<< static_cast<int>(receivedMsg->type) << "\n";
-
-            	// COEN320 Lab 4_5: Handle different message types from Communications System
-                switch (receivedMsg->type) {
-                    case MessageType::REQUEST_CHANGE_OF_HEADING: {
-                        msg_change_heading* heading_data = reinterpret_cast<msg_change_heading*>(receivedMsg->data.data());
-                        std::cout << "Aircraft " << id << " received heading change command\n";
-                        std::cout << "  New velocities: VX=" << heading_data->VelocityX
-                                  << " VY=" << heading_data->VelocityY
-                                  << " VZ=" << heading_data->VelocityZ << "\n";
-
-                        // Apply the heading change
-                        changeHeading(heading_data->VelocityX, heading_data->VelocityY, heading_data->VelocityZ);
-
-                        // Reply to acknowledge
-                        MsgReply(rcvid, 0, NULL, 0);
-                        break;
-                    }
-
-                    case MessageType::REQUEST_CHANGE_POSITION: {
-                        msg_change_position* pos_data = reinterpret_cast<msg_change_position*>(receivedMsg->data.data());
-                        std::cout << "Aircraft " << id << " received position change command\n";
-                        std::cout << "  New position: X=" << pos_data->x
-                                  << " Y=" << pos_data->y
-                                  << " Z=" << pos_data->z << "\n";
-
-                        // Apply the position change
-                        posX = pos_data->x;
-                        posY = pos_data->y;
-                        posZ = pos_data->z;
-
-                        std::cout << "Aircraft " << id << " position updated\n";
-
-                        // Reply to acknowledge
-                        MsgReply(rcvid, 0, NULL, 0);
-                        break;
-                    }
-
-                    case MessageType::REQUEST_CHANGE_ALTITUDE: {
-                        msg_change_heading* altitude_data = reinterpret_cast<msg_change_heading*>(receivedMsg->data.data());
-                        std::cout << "Aircraft " << id << " received altitude change command\n";
-                        std::cout << "  New altitude: Z=" << altitude_data->altitude << "\n";
-
-                        // Apply the altitude change
-                        posZ = altitude_data->altitude;
-
-                        std::cout << "Aircraft " << id << " altitude updated to " << posZ << "\n";
-
-                        // Reply to acknowledge
-                        MsgReply(rcvid, 0, NULL, 0);
-                        break;
-                    }
-                    // if this is printed out its usually because communications system channel didn't send properly
-                    default:
-                        std::cerr << "Aircraft " << id << " received unknown inter-process message type: " << static_cast<int>(receivedMsg->type) << "\n";
-                        MsgReply(rcvid, -1, NULL, 0);
-                        break;
-                }
-            } else {  // from Radar
-            	// Message is recast to type Message
-            	Message* receivedMsg = reinterpret_cast<Message*>(buffer);
-
-            	if (receivedMsg->type == MessageType::REQUEST_POSITION) {
-            		msg_plane_info positionData = {id, posX, posY, posZ, speedX, speedY, speedZ};
-            	    Message posUpdateMessage = createPositionUpdateMessage(id, positionData);
-
-            	    MsgReply(rcvid, 0, &posUpdateMessage, sizeof(posUpdateMessage)); // Send reply with position
-            	}
-            }
+        // Push mode: publish the new state instead of waiting to be polled
+        if (positionTable) {
+            positionTable->update(positionSlot, currentState());
         }
 
-        // Wait for the next time step
-        timer.waitTimer();
+        // Answer the Radar and take commands until the next step is due
+        if (!waitStep()) {
+            if (positionTable) {
+                positionTable->releaseSlot(positionSlot);
+            }
+            break;
+        }
     }
 
     name_detach(Plane_channel, 0);
-    pthread_exit(NULL);
 
     return 0;
 }
 
 
+bool Aircraft::postCommand(const Message_inter_process& msg) {
+	switch (msg.type) {
+	case MessageType::REQUEST_CHANGE_OF_HEADING:
+	case MessageType::REQUEST_CHANGE_POSITION:
+	case MessageType::REQUEST_CHANGE_ALTITUDE:
+		return inbox.push(msg);
+	default:
+		std::cerr << "Aircraft " << id << " received unknown inter-process message type: " << static_cast<int>(msg.type) << "\n";
+		return false;
+	}
+}
+
+// Answers the Radar's position requests as they arrive and queues operator commands for the
+// next step, until deadlineNs on CLOCK_MONOTONIC. A deadline of 0 only takes what is already queued.
+void Aircraft::serveChannel(name_attach_t* channel, uint64_t deadlineNs) {
+    char buffer[sizeof(Message_inter_process)];  // Buffer to handle largest message size
+    while (true) {
+        if (deadlineNs) {
+            TimerTimeout(CLOCK_MONOTONIC, _NTO_TIMEOUT_RECEIVE | TIMER_ABSTIME, NULL, &deadlineNs, NULL);
+        } else {
+            uint64_t noWait = 0;
+            TimerTimeout(CLOCK_MONOTONIC, _NTO_TIMEOUT_RECEIVE, NULL, &noWait, NULL);
+        }
+        int rcvid = MsgReceive(channel->chid, buffer, sizeof(buffer), NULL);
+        if (rcvid == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;  // Timed out: the next step is due
+        }
+        // Skip pulses
+        if (rcvid == 0) {
+            continue;
+        }
+
+        // Determine message type by checking the MessageType field and recast
+        Message* baseMsg = reinterpret_cast<Message*>(buffer);
+
+        MessageType msgType = baseMsg->type;
+        int typeValue = static_cast<int>(msgType);
+
+        // Valid MessageType enum values are 0-10 so anyhting else is an error
+        // If we get  data (like 223) it's from Radar which doesn't properly connect it means
+        // REQUEST_POSITION (3) is always from Radar
+        // Types 4-10 are from Communications System and are our operator commands we input
+        bool isValidType = (typeValue >= 0 && typeValue <= 10);
+        bool isInterProcess = isValidType && (msgType != MessageType::REQUEST_POSITION);
+
+        if (isInterProcess) {  // if its from Communications System
+            // Recast it to be of type Message_inter_process
+            Message_inter_process* receivedMsg = reinterpret_cast<Message_inter_process*>(buffer);
+
+            // Applied at the start of the next step, like commands from the command listener
+            MsgReply(rcvid, postCommand(*receivedMsg) ? 0 : -1, NULL, 0);
+        } else if (msgType == MessageType::REQUEST_POSITION) {  // from Radar
+            msg_plane_info positionData = currentState();
+            Message_position_reply posUpdateMessage = createPositionUpdateMessage(id, positionData);
+
+            MsgReply(rcvid, 0, &posUpdateMessage, sizeof(posUpdateMessage)); // Send reply with position
+        }
+    }
+}
+
+void Aircraft::applyCommands() {
+    Message_inter_process msg;
+    while (inbox.pop(msg)) {
+        applyCommand(msg);
+    }
+}
+
+// COEN320 Lab 4_5: Handle different message types from Communications System
+void Aircraft::applyCommand(const Message_inter_process& msg) {
+    switch (msg.type) {
+        case MessageType::REQUEST_CHANGE_OF_HEADING: {
+            const msg_change_heading* heading_data = reinterpret_cast<const msg_change_heading*>(msg.data.data());
+            std::cout << "Aircraft " << id << " received heading change command\n";
+            std::cout << "  New velocities: VX=" << heading_data->VelocityX
+                      << " VY=" << heading_data->VelocityY
+                      << " VZ=" << heading_data->VelocityZ << "\n";
+
+            // Apply the heading change
+            changeHeading(heading_data->VelocityX, heading_data->VelocityY, heading_data->VelocityZ);
+            break;
+        }
+
+        case MessageType::REQUEST_CHANGE_POSITION: {
+            const msg_change_position* pos_data = reinterpret_cast<const msg_change_position*>(msg.data.data());
+            std::cout << "Aircraft " << id << " received position change command\n";
+            std::cout << "  New position: X=" << pos_data->x
+                      << " Y=" << pos_data->y
+                      << " Z=" << pos_data->z << "\n";
+
+            // Apply the position change
+            posX = pos_data->x;
+            posY = pos_data->y;
+            posZ = pos_data->z;
+            maneuverCount++;
+
+            std::cout << "Aircraft " << id << " position updated\n";
+            break;
+        }
+
+        case MessageType::REQUEST_CHANGE_ALTITUDE: {
+            const msg_change_heading* altitude_data = reinterpret_cast<const msg_change_heading*>(msg.data.data());
+            std::cout << "Aircraft " << id << " received altitude change command\n";
+            std::cout << "  New altitude: Z=" << altitude_data->altitude << "\n";
+
+            // Apply the altitude change
+            posZ = altitude_data->altitude;
+            maneuverCount++;
+
+            std::cout << "Aircraft " << id << " altitude updated to " << posZ << "\n";
+            break;
+        }
+
+        default:
+            break;  // postCommand only queues the three above
+    }
+}
+
+
+msg_plane_info Aircraft::currentState() const {
+	// The maneuver count lets the Radar tell a commanded change from ordinary motion
+	msg_plane_info info = {id, maneuverCount << PLANE_INFO_MANEUVER_SHIFT, posX, posY, posZ, speedX, speedY, speedZ};
+	return info;
+}
+
 int Aircraft::getArrivalTime() {
 	return arrivalTime;
 }
@@ -273,13 +384,15 @@ Message Aircraft::createExitAirspaceMessage(int planeID){ // done?
 	return msg;
 }
 //Coen320_Lab3(Task4): complete the createPositionUpdateMessage function with what you learned above
-Message Aircraft::createPositionUpdateMessage(int planeID, const msg_plane_info& info) { //done?
+Message_position_reply Aircraft::createPositionUpdateMessage(int planeID, const msg_plane_info& info) { //done?
 
-    Message msg;
-    msg.type =MessageType::POSITION_UPDATE; // Use the correct Message type
-    msg.planeID = planeID ;// Use the passed Plane ID
-    msg.data = (void*)&info;  // Allocate and copy info data
+    Message_position_reply reply;
+    reply.message.type =MessageType::POSITION_UPDATE; // Use the correct Message type
+    reply.message.planeID = planeID ;// Use the passed Plane ID
+    reply.message.data = NULL;  // The info is copied into the reply, not pointed to
+    reply.message.dataSize = sizeof(info);
+    reply.info = info;
 
-    return msg;
+    return reply;
 
 }
@@ -1,10 +1,15 @@
 #ifndef AIRCRAFT_H_
 #define AIRCRAFT_H_
 
+#include <atomic>
 #include <iostream>
+#include <memory>
 #include <sys/dispatch.h>
 #include <thread>
 #include "Msg_structs.h"
+#include "PositionTable.h"
+#include "VirtualClock.h"
+#include "CommandInbox.h"
 
 
 typedef struct {
@@ -16,10 +21,20 @@ int lower_z_boundary;
 int upper_z_boundary;
 } airspace_struct;
 
+// Bounds every aircraft flies within; it leaves the airspace once past one of them
+const airspace_struct DEFAULT_AIRSPACE = {0, 100000, 0, 100000, 15000, 40000};
+
+// Operator commands an aircraft holds between two steps before it refuses more
+const uint32_t AIRCRAFT_INBOX_CAPACITY = 16;
+
 class Aircraft {
 public:
 	// Constructor
-    Aircraft(int id, double x, double y, double z, double sx, double sy, double sz, int Arrivalt);
+    // positionTable selects push mode: the aircraft publishes its state there after every step
+    // stepMs is the simulation step; speeds are per second and scaled by it
+    // startMs is the simulation time the aircraft is created at; it waits for Arrivalt from there
+    // A virtualClock replaces the aircraft's timer: it steps once per tick, in the aircraft stage
+    Aircraft(int id, double x, double y, double z, double sx, double sy, double sz, int Arrivalt, PositionTable* positionTable = nullptr, uint32_t stepMs = 1000, uint64_t startMs = 0, VirtualClock* virtualClock = nullptr);
     ~Aircraft();
 
     //print initial aircraft info
@@ -38,23 +53,39 @@ public:
     //change heading by changing speed in the xyz direction
     void changeHeading(double Vx, double Vy, double Vz);
 
+    // Queue a heading, position or altitude command for the start of the next step.
+    // Safe from any thread; false if it is not one of those or the inbox is full.
+    bool postCommand(const Message_inter_process& msg);
+
 
 
     pthread_t thread_id;   // Thread for updating position
+    std::atomic<bool> finished;  // Set once the thread is done and can be joined without blocking
 
 private:
     int id;                     // Plane ID
     double posX, posY, posZ;    // Position
     double speedX, speedY, speedZ; // Speed
-    int arrivalTime;            // Time of Arrival
+    int arrivalTime;            // Time of Arrival (s)
+    uint32_t stepMs;            // Simulation step
+    uint64_t startMs;           // Simulation time at creation
     int message_id;				//to identify who sends the service
     bool inAirspace;
     int Radar_id;
     airspace_struct airspace;
+    PositionTable* positionTable;	// nullptr in pull mode
+    int positionSlot;				// Slot in positionTable while in the airspace
+    int maneuverCount;				// Heading, position and altitude commands applied so far
+    std::unique_ptr<ClockParticipant> clockParticipant;	// Handed to the thread; nullptr in real time
+    CommandInbox<Message_inter_process, AIRCRAFT_INBOX_CAPACITY> inbox;	// Drained by the aircraft's thread only
+    msg_plane_info currentState() const;
+    void serveChannel(name_attach_t* channel, uint64_t deadlineNs);
+    void applyCommands();
+    void applyCommand(const Message_inter_process& msg);
     //Message creation
     Message createEnterAirspaceMessage(int planeID);
     Message createExitAirspaceMessage(int planeID);
-    Message createPositionUpdateMessage(int planeID, const msg_plane_info& info);
+    Message_position_reply createPositionUpdateMessage(int planeID, const msg_plane_info& info);
 };
 
 #endif /* AIRCRAFT_H_ */
@@ -0,0 +1,61 @@
+#include "AircraftPool.h"
+
+AircraftPool::AircraftPool() : slotsUsed(SLOTS_PER_BLOCK), liveCount(0), highWaterMark(0), slotCount(0), reuseCount(0) {}
+
+AircraftPool::Slot* AircraftPool::acquireSlot(bool& reused) {
+	reused = !freeSlots.empty();
+	if (reused) {
+		Slot* slot = freeSlots.back();
+		freeSlots.pop_back();
+		return slot;
+	}
+
+	if (slotsUsed == SLOTS_PER_BLOCK) {
+		void* block = nullptr;
+		if (posix_memalign(&block, alignof(Slot), SLOTS_PER_BLOCK * sizeof(Slot)) != 0) {
+			throw std::bad_alloc();
+		}
+		std::unique_ptr<Slot[], BlockDeleter> owned(static_cast<Slot*>(block));
+		blocks.push_back(std::move(owned));
+		slotsUsed = 0;
+		slotCount.store(blocks.size() * SLOTS_PER_BLOCK, std::memory_order_relaxed);
+	}
+	return &blocks.back()[slotsUsed++];
+}
+
+void AircraftPool::countCreated(bool reused) {
+	size_t live = liveCount.load(std::memory_order_relaxed) + 1;
+	liveCount.store(live, std::memory_order_relaxed);
+	if (live > highWaterMark.load(std::memory_order_relaxed)) {
+		highWaterMark.store(live, std::memory_order_relaxed);
+	}
+	if (reused) {
+		reuseCount.store(reuseCount.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	}
+}
+
+void AircraftPool::release(Aircraft* aircraft) {
+	if (!aircraft) {
+		return;
+	}
+	aircraft->~Aircraft();
+	// The aircraft was built at the start of its slot
+	freeSlots.push_back(reinterpret_cast<Slot*>(aircraft));
+	liveCount.store(liveCount.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+}
+
+size_t AircraftPool::getLiveCount() const {
+	return liveCount.load(std::memory_order_relaxed);
+}
+
+size_t AircraftPool::getHighWaterMark() const {
+	return highWaterMark.load(std::memory_order_relaxed);
+}
+
+size_t AircraftPool::getSlotCount() const {
+	return slotCount.load(std::memory_order_relaxed);
+}
+
+uint64_t AircraftPool::getReuseCount() const {
+	return reuseCount.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,89 @@
+/*
+ * Storage for the Aircraft of a thread-per-aircraft run.
+ *
+ * Aircraft are constructed in place in fixed-size slots, allocated in blocks
+ * that are kept for the whole run. An aircraft that has left the airspace
+ * (its thread joined) gives its slot back and the next arrival is built in
+ * it, so in a long continuous run memory follows the peak number of aircraft
+ * flying at once rather than the number that ever flew. Freed slots are
+ * reused last-in first-out, while still warm in cache.
+ *
+ * Only the scheduler creates and releases aircraft, so the pool takes no lock;
+ * the counters are atomic so they can be read from elsewhere.
+ */
+
+#ifndef AIRCRAFTPOOL_H_
+#define AIRCRAFTPOOL_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+#include "Aircraft.h"
+
+class AircraftPool {
+public:
+	AircraftPool();
+
+	AircraftPool(const AircraftPool&) = delete;
+	AircraftPool& operator=(const AircraftPool&) = delete;
+
+	// Construct an Aircraft in a free slot; takes the Aircraft constructor's arguments.
+	// If the constructor throws, the slot goes back to the free list uncounted.
+	template <typename... Args>
+	Aircraft* create(Args&&... args) {
+		bool reused = false;
+		Slot* slot = acquireSlot(reused);
+		Aircraft* aircraft;
+		try {
+			aircraft = new (slot->storage) Aircraft(std::forward<Args>(args)...);
+		} catch (...) {
+			freeSlots.push_back(slot);
+			throw;
+		}
+		countCreated(reused);
+		return aircraft;
+	}
+
+	// Destroy an aircraft whose thread has been joined and recycle its slot.
+	// Every aircraft has to be released before the pool goes.
+	void release(Aircraft* aircraft);
+
+	size_t getLiveCount() const;		// Aircraft constructed and not yet released
+	size_t getHighWaterMark() const;	// Most aircraft live at once
+	size_t getSlotCount() const;		// Slots allocated so far (live or free)
+	uint64_t getReuseCount() const;		// Aircraft built in a recycled slot
+
+private:
+	struct Slot {
+		alignas(Aircraft) unsigned char storage[sizeof(Aircraft)];
+	};
+
+	static const size_t SLOTS_PER_BLOCK = 64;
+
+	// Blocks come from posix_memalign: Aircraft is over-aligned (its inbox keeps
+	// the producer and consumer positions on separate cache lines), which new[]
+	// does not honour before C++17
+	struct BlockDeleter {
+		void operator()(Slot* block) const { std::free(block); }
+	};
+
+	// A free slot, or a new one; `reused` tells which
+	Slot* acquireSlot(bool& reused);
+	// Counts an aircraft that was constructed
+	void countCreated(bool reused);
+
+	std::vector<std::unique_ptr<Slot[], BlockDeleter>> blocks;
+	size_t slotsUsed;				// Slots of the last block handed out at least once
+	std::vector<Slot*> freeSlots;	// Released slots, reused last first
+	std::atomic<size_t> liveCount;
+	std::atomic<size_t> highWaterMark;
+	std::atomic<size_t> slotCount;
+	std::atomic<uint64_t> reuseCount;
+};
+
+#endif /* AIRCRAFTPOOL_H_ */
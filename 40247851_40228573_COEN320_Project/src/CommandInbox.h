@@ -0,0 +1,81 @@
+/*
+ * Bounded lock-free multi-producer single-consumer queue, one per aircraft.
+ *
+ * Operator commands reach an aircraft from other threads (the command
+ * listener, or the aircraft's own channel) at any time, but may only change
+ * its state between two steps. Producers push without blocking and get false
+ * when the inbox is full; the aircraft pops everything at the start of its
+ * next step, so a command takes effect within one step of arriving.
+ *
+ * Each cell carries a sequence number telling producers and the consumer
+ * whose turn it is, so a push is one compare-and-swap on the enqueue position
+ * and a pop touches no shared counter at all.
+ */
+
+#ifndef COMMANDINBOX_H_
+#define COMMANDINBOX_H_
+
+#include <atomic>
+#include <cstdint>
+
+template <typename T, uint32_t Capacity>
+class CommandInbox {
+	static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "CommandInbox capacity must be a power of two");
+
+public:
+	CommandInbox() : enqueuePos(0), dequeuePos(0) {
+		for (uint32_t i = 0; i < Capacity; ++i) {
+			cells[i].sequence.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	CommandInbox(const CommandInbox&) = delete;
+	CommandInbox& operator=(const CommandInbox&) = delete;
+
+	// Any thread. False when the inbox is full.
+	bool push(const T& value) {
+		uint32_t pos = enqueuePos.load(std::memory_order_relaxed);
+		Cell* cell;
+		while (true) {
+			cell = &cells[pos & (Capacity - 1)];
+			int32_t diff = static_cast<int32_t>(cell->sequence.load(std::memory_order_acquire) - pos);
+			if (diff == 0) {
+				// The cell is free for this position; claim it
+				if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+					break;
+				}
+			} else if (diff < 0) {
+				return false;  // The consumer has not freed it yet
+			} else {
+				pos = enqueuePos.load(std::memory_order_relaxed);  // Another producer took it
+			}
+		}
+		cell->value = value;
+		cell->sequence.store(pos + 1, std::memory_order_release);
+		return true;
+	}
+
+	// The owning aircraft only. False when nothing is queued.
+	bool pop(T& value) {
+		Cell& cell = cells[dequeuePos & (Capacity - 1)];
+		if (static_cast<int32_t>(cell.sequence.load(std::memory_order_acquire) - (dequeuePos + 1)) < 0) {
+			return false;
+		}
+		value = cell.value;
+		cell.sequence.store(dequeuePos + Capacity, std::memory_order_release);
+		dequeuePos++;
+		return true;
+	}
+
+private:
+	struct Cell {
+		std::atomic<uint32_t> sequence;
+		T value;
+	};
+
+	Cell cells[Capacity];
+	alignas(64) std::atomic<uint32_t> enqueuePos;	// Shared by the producers
+	alignas(64) uint32_t dequeuePos;				// Consumer only
+};
+
+#endif /* COMMANDINBOX_H_ */
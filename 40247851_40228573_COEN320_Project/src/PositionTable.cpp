@@ -0,0 +1,107 @@
+#include "PositionTable.h"
+#include <thread>
+
+PositionTable::PositionTable() : slotCount(0), occupiedCount(0) {
+	for (size_t i = 0; i < MAX_CHUNKS; ++i) {
+		chunks[i].store(nullptr, std::memory_order_relaxed);
+	}
+}
+
+PositionTable::~PositionTable() {
+	for (size_t i = 0; i < MAX_CHUNKS; ++i) {
+		delete[] chunks[i].load(std::memory_order_relaxed);
+	}
+}
+
+PositionTable::Slot& PositionTable::slotAt(size_t index) const {
+	return chunks[index / SLOTS_PER_CHUNK].load(std::memory_order_acquire)[index % SLOTS_PER_CHUNK];
+}
+
+int PositionTable::acquireSlot(const msg_plane_info& info) {
+	std::lock_guard<std::mutex> lock(allocationMutex);
+
+	int slot;
+	if (!freeSlots.empty()) {
+		slot = freeSlots.back();
+		freeSlots.pop_back();
+	} else {
+		size_t index = slotCount.load(std::memory_order_relaxed);
+		size_t chunk = index / SLOTS_PER_CHUNK;
+		if (chunk >= MAX_CHUNKS) {
+			return -1;
+		}
+		if (index % SLOTS_PER_CHUNK == 0) {
+			Slot* slots = new Slot[SLOTS_PER_CHUNK];
+			for (size_t i = 0; i < SLOTS_PER_CHUNK; ++i) {
+				slots[i].sequence.store(0, std::memory_order_relaxed);
+				slots[i].occupied = false;
+			}
+			chunks[chunk].store(slots, std::memory_order_release);
+		}
+		slot = index;
+		slotCount.store(index + 1, std::memory_order_release);
+	}
+
+	write(slotAt(slot), true, info);
+	occupiedCount++;
+	return slot;
+}
+
+void PositionTable::releaseSlot(int slot) {
+	if (slot < 0) {
+		return;
+	}
+
+	Slot& entry = slotAt(slot);
+	write(entry, false, entry.info);
+	occupiedCount--;
+
+	std::lock_guard<std::mutex> lock(allocationMutex);
+	freeSlots.push_back(slot);
+}
+
+void PositionTable::update(int slot, const msg_plane_info& info) {
+	if (slot >= 0) {
+		write(slotAt(slot), true, info);
+	}
+}
+
+void PositionTable::write(Slot& slot, bool occupied, const msg_plane_info& info) {
+	uint32_t sequence = slot.sequence.load(std::memory_order_relaxed);
+	slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	slot.occupied = occupied;
+	slot.info = info;
+
+	slot.sequence.store(sequence + 2, std::memory_order_release);
+}
+
+void PositionTable::snapshot(std::vector<msg_plane_info>& planes) const {
+	size_t count = slotCount.load(std::memory_order_acquire);
+	for (size_t i = 0; i < count; ++i) {
+		const Slot& slot = slotAt(i);
+		while (true) {
+			uint32_t sequence = slot.sequence.load(std::memory_order_acquire);
+			if (sequence & 1) {
+				std::this_thread::yield();
+				continue;
+			}
+
+			bool occupied = slot.occupied;
+			msg_plane_info info = slot.info;
+
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (slot.sequence.load(std::memory_order_relaxed) == sequence) {
+				if (occupied) {
+					planes.push_back(info);
+				}
+				break;
+			}
+		}
+	}
+}
+
+size_t PositionTable::getOccupiedCount() const {
+	return occupiedCount.load();
+}
@@ -0,0 +1,66 @@
+/*
+ * Table of aircraft states for push-mode position reporting.
+ *
+ * In pull mode the Radar asks every aircraft for its position with
+ * REQUEST_POSITION. In push mode each aircraft thread owns one slot of this
+ * table and writes its state into it after every step; the Radar assembles a
+ * frame by reading the table, with no per-aircraft round-trips.
+ *
+ * Slots are claimed on ENTER_AIRSPACE and released on EXIT_AIRSPACE. Each slot
+ * has a single writer (its aircraft) and is published under its own sequence
+ * counter, so the Radar reads it without locking. Slots live in fixed-size
+ * chunks that are never moved, so the table can grow while being read.
+ */
+
+#ifndef POSITIONTABLE_H_
+#define POSITIONTABLE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "Msg_structs.h"
+
+class PositionTable {
+public:
+	PositionTable();
+	~PositionTable();
+
+	// Claim a slot for an aircraft entering the airspace, published with its
+	// initial state; returns -1 if the table is full
+	int acquireSlot(const msg_plane_info& info);
+
+	// Give the slot back when the aircraft leaves the airspace
+	void releaseSlot(int slot);
+
+	// Publish the aircraft's latest state (called by the owning aircraft only)
+	void update(int slot, const msg_plane_info& info);
+
+	// Append a consistent copy of every occupied slot to `planes`
+	void snapshot(std::vector<msg_plane_info>& planes) const;
+
+	size_t getOccupiedCount() const;
+
+private:
+	struct Slot {
+		std::atomic<uint32_t> sequence;	// Seqlock counter: odd while the aircraft is writing
+		bool occupied;
+		msg_plane_info info;
+	};
+
+	static const size_t SLOTS_PER_CHUNK = 256;
+	static const size_t MAX_CHUNKS = 1024;
+
+	Slot& slotAt(size_t index) const;
+	void write(Slot& slot, bool occupied, const msg_plane_info& info);
+
+	std::atomic<Slot*> chunks[MAX_CHUNKS];
+	std::atomic<size_t> slotCount;			// Slots handed out so far (occupied or free)
+	std::atomic<size_t> occupiedCount;
+	std::vector<int> freeSlots;				// Released slots ready for reuse
+	std::mutex allocationMutex;				// Guards slot allocation, not the slot contents
+};
+
+#endif /* POSITIONTABLE_H_ */
@@ -1,19 +1,43 @@
 #include "Radar.h"
 #include <sys/dispatch.h>
+#include <algorithm>
 
+namespace {
 
-Radar::Radar(uint64_t& tick_counter) : tick_counter_ref(tick_counter), activeBufferIndex(0), timer(1,0), stopThreads(false) {
-	clearSharedMemory(); //For future Use
+// An aircraft that did not answer before the sweep deadline. The only failure
+// reported stale; any other means the aircraft is gone or was never reachable.
+struct SweepDeadlineMissed : std::runtime_error {
+	using std::runtime_error::runtime_error;
+};
+
+}
+
+Radar::Radar(uint64_t& tick_counter, const RadarConfig& radarConfig, PositionTable* table, VirtualClock* clock) : tick_counter_ref(tick_counter), config(radarConfig), positionTable(table), virtualClock(clock), sweepPool(table ? 1 : std::max(radarConfig.sweepWorkers, 1u)), connectionCacheHits(0), connectionCacheMisses(0), Radar_channel(NULL), activeBufferIndex(0), timer(std::max(radarConfig.sweepPeriodMs, 1u) / 1000, std::max(radarConfig.sweepPeriodMs, 1u) % 1000), stopThreads(false) {
+	// Map the shared memory once; every sweep after this only writes through the mapping.
+	// The last historyDepth sweeps stay readable in the segment's frame ring.
+	if (!airspaceWriter.open(AIRSPACE_INITIAL_CAPACITY, config.historyDepth, config.keyframeInterval, config.frameLayout)) {
+		std::cerr << "Radar: shared memory unavailable, frames will not be published" << std::endl;
+	}
+
+	// A sweep has to be finished, stale aircraft included, before the next one starts
+	config.sweepPeriodMs = std::max(config.sweepPeriodMs, 1u);
+	if (config.sweepDeadlineMs >= config.sweepPeriodMs) {
+		config.sweepDeadlineMs = config.sweepPeriodMs * 9 / 10;
+	}
+
+	// One partial buffer per poller; with a single poller the sweep thread does the work itself
+	partialBuffers.resize(sweepPool.size());
+	missedPlanes.resize(sweepPool.size());
 	// Start threads for listening to airspace events
     Arrival_Departure = std::thread(&Radar::ListenAirspaceArrivalAndDeparture, this);
     UpdatePosition = std::thread(&Radar::ListenUpdatePosition, this);
-    Radar_channel = NULL;
 }
 
 Radar::~Radar() {
     // Join threads to ensure proper cleanup
     shutdown();
-    clearSharedMemory();//For future Use */
+    clearSharedMemory();
+    airspaceWriter.close();
 }
 
 void Radar::shutdown() {
@@ -31,6 +55,12 @@ void Radar::shutdown() {
     if (UpdatePosition.joinable()) {
         UpdatePosition.join();
     }
+
+    closeAllPlaneConnections();
+    std::cout << "Radar: " << sweepCount << " sweeps in " << (positionTable ? "push" : "pull")
+              << " mode, average " << getAverageSweepTime() << " ms, max " << maxSweepTime << " ms" << std::endl;
+    std::cout << "Radar: connection cache hits " << connectionCacheHits.load()
+              << ", misses " << connectionCacheMisses.load() << std::endl;
 }
 
 
@@ -59,8 +89,13 @@ void Radar::ListenAirspaceArrivalAndDeparture() {
         }
 
         // Reply back to the client
+        // Pull mode replies first: opening the aircraft's connection needs it back in MsgReceive.
+        // Push mode opens nothing and replies last, so the sender's tick has updated the airspace
+        // before the sweep of that tick.
         int msg_ret = msg.planeID;
-        MsgReply(rcvid, 0, &msg_ret, sizeof(msg_ret)); // Send plane's ID back to airplane
+        if (!positionTable) {
+            MsgReply(rcvid, 0, &msg_ret, sizeof(msg_ret)); // Send plane's ID back to airplane
+        }
 
         switch (msg.type) {
         case MessageType::ENTER_AIRSPACE:
@@ -75,26 +110,53 @@ void Radar::ListenAirspaceArrivalAndDeparture() {
         	break;
         }
 
+        if (positionTable) {
+            MsgReply(rcvid, 0, &msg_ret, sizeof(msg_ret));
+        }
+
     }
 }
 
 void Radar::ListenUpdatePosition() {
+    // Virtual clock: the Radar takes part in every tick, after the aircraft, and sweeps in the
+    // first tick at or past the next sweep time
+    std::unique_ptr<ClockParticipant> participant;
+    uint64_t nextSweepMs = config.sweepPeriodMs;
+    if (virtualClock) {
+        participant.reset(new ClockParticipant(*virtualClock, CLOCK_STAGE_RADAR));
+    }
 
     while (!stopThreads.load()) {
-    	timer.waitTimer(); // Wait for the next timer interval before polling again
+    	if (participant) {
+    		if (!participant->waitUntil([&]() { return participant->now() >= nextSweepMs; })) {
+    			break;  // Clock stopped
+    		}
+    		nextSweepMs = participant->now() + config.sweepPeriodMs;
+    	} else {
+    		timer.waitTimer(); // Wait for the next timer interval before polling again
+    	}
+
+    	airspaceMutex.lock();
+    	bool isAirspaceEmpty = planesInAirspace.empty();
+    	airspaceMutex.unlock();
+
     	// Only poll airspace if there are planes
-        if (!planesInAirspace.empty()) {
+        if (!isAirspaceEmpty) {
             pollAirspace();  // Call pollAirspace() to gather position data
-            writeToSharedMemory();  // Write active buffer to shared memory //For future Use
+            writeToSharedMemory();  // Write active buffer to shared memory
             wasAirspaceEmpty = false;
         } else if (!wasAirspaceEmpty){
         	// Only write empty buffer once after transition to empty
-        	writeToSharedMemory();  // Write to shared mem when all planes have left the airspace //For future Use
+        	pollAirspace();  // Swaps in an empty buffer
+        	writeToSharedMemory();  // Write to shared mem when all planes have left the airspace
         	wasAirspaceEmpty = true;  // Set flag to indicate airspace is empty
         } else{
         	//std::cout << "Airspace is empty\n";
         }
 
+        if (participant) {
+        	participant->complete();
+        }
     }
 }
 
@@ -102,47 +164,128 @@ void Radar::pollAirspace(){
 
 	airspaceMutex.lock();
 	// Make a copy of the current planes in airspace to avoid modification during iteration
-	std::unordered_set<int> planesToPoll = planesInAirspace;
+	sweepIds.assign(planesInAirspace.begin(), planesInAirspace.end());
 	airspaceMutex.unlock();
 
 	int inactiveBufferIndex = (activeBufferIndex + 1) % 2;
 	std::vector<msg_plane_info>& inactiveBuffer = planesInAirspaceData[inactiveBufferIndex];
 	inactiveBuffer.clear();
 
+	timer.tick();
+
+	// Push mode: every aircraft has already written its state into the table
+	if (positionTable) {
+		positionTable->snapshot(inactiveBuffer);
+		std::sort(inactiveBuffer.begin(), inactiveBuffer.end(),
+				[](const msg_plane_info& a, const msg_plane_info& b) { return a.id < b.id; });
+		{
+			std::lock_guard<std::mutex> lock(bufferSwitchMutex);
+			activeBufferIndex = inactiveBufferIndex;
+		}
+		recordSweepTime(timer.tock());
+		return;
+	}
+
+	sweepDeadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(config.sweepDeadlineMs);
+	sweepTime = tick_counter_ref;
+	sweepPool.run([this](unsigned index) { pollSlice(index, sweepPool.size()); });
+
+	// Merge the partial buffers. Aircraft that did not answer in time keep their
+	// last-known data, flagged stale and moved along its velocity to this sweep,
+	// instead of dropping out of the frame. One that left during the sweep is dropped.
+	{
+		std::lock_guard<std::mutex> lock(airspaceMutex);
+		for (unsigned i = 0; i < partialBuffers.size(); ++i) {
+			for (const msg_plane_info& plane_info : partialBuffers[i]) {
+				lastKnownData[plane_info.id] = {plane_info, sweepTime};
+				inactiveBuffer.emplace_back(plane_info);
+			}
+			for (int planeID : missedPlanes[i]) {
+				auto it = lastKnownData.find(planeID);
+				if (it != lastKnownData.end() && planesInAirspace.count(planeID)) {
+					msg_plane_info plane_info = it->second.info;
+					double age = (sweepTime - it->second.time) / 1000.0;  // Seconds
+					plane_info.PositionX += plane_info.VelocityX * age;
+					plane_info.PositionY += plane_info.VelocityY * age;
+					plane_info.PositionZ += plane_info.VelocityZ * age;
+					plane_info.flags |= PLANE_INFO_STALE;
+					inactiveBuffer.emplace_back(plane_info);
+				}
+			}
+		}
+	}
+
+	// Forget planes that have left the airspace
+	if (lastKnownData.size() > sweepIds.size()) {
+		std::unordered_set<int> polled(sweepIds.begin(), sweepIds.end());
+		for (auto it = lastKnownData.begin(); it != lastKnownData.end();) {
+			it = polled.count(it->first) ? std::next(it) : lastKnownData.erase(it);
+		}
+	}
+
+	// Frames are published sorted by id so readers can look a plane up by binary search
+	std::sort(inactiveBuffer.begin(), inactiveBuffer.end(),
+			[](const msg_plane_info& a, const msg_plane_info& b) { return a.id < b.id; });
+
+	// Publish the freshly filled buffer once the whole sweep is done
+	{
+		std::lock_guard<std::mutex> lock(bufferSwitchMutex);
+	    activeBufferIndex = inactiveBufferIndex;
+	}
+	recordSweepTime(timer.tock());
+}
+
+void Radar::recordSweepTime(double elapsed) {
+	sweepCount++;
+	totalSweepTime += elapsed;
+	maxSweepTime = std::max(maxSweepTime, elapsed);
+}
+
+uint64_t Radar::getSweepCount() const {
+	return sweepCount;
+}
+
+double Radar::getAverageSweepTime() const {
+	return sweepCount ? totalSweepTime / sweepCount : 0;
+}
+
+// Polls every stride-th ID of this sweep, starting at index
+void Radar::pollSlice(unsigned index, unsigned stride) {
+	std::vector<msg_plane_info>& partialBuffer = partialBuffers[index];
+	std::vector<int>& missed = missedPlanes[index];
+	partialBuffer.clear();
+	missed.clear();
 
 	//make channel to aircraft
-	for (int planeID: planesToPoll){
+	for (size_t i = index; i < sweepIds.size(); i += stride) {
+		int planeID = sweepIds[i];
 
 		airspaceMutex.lock();
 		bool isPlaneInAirspace = planesInAirspace.find(planeID) != planesInAirspace.end();
 		airspaceMutex.unlock();
-		if (isPlaneInAirspace){
-			try {
-			// Confirm that the plane is still in airspace
-				msg_plane_info plane_info = getAircraftData(planeID);
-				inactiveBuffer.emplace_back(plane_info);
-			} catch (const std::exception& e) {
-				// if error to process plane get next id and exception description
-				//std::cerr << "Radar: Failed to get plane data " << planeID << ": " << e.what() << "\n";
-				continue;
-			}
+		if (!isPlaneInAirspace) {
+			continue;
 		}
 
+		if (std::chrono::steady_clock::now() >= sweepDeadline) {
+			missed.push_back(planeID);
+			continue;
+		}
 
-		{
-			std::lock_guard<std::mutex> lock(bufferSwitchMutex);
-		    activeBufferIndex = inactiveBufferIndex;
+		try {
+			partialBuffer.emplace_back(getAircraftData(planeID, sweepDeadline));
+		} catch (const SweepDeadlineMissed&) {
+			missed.push_back(planeID);
+		} catch (const std::exception& e) {
+			// Gone (e.g. detached right after EXIT_AIRSPACE) or unreachable: left out of the frame
+			//std::cerr << "Radar: Failed to get plane data " << planeID << ": " << e.what() << "\n";
 		}
 	}
 }
 
-msg_plane_info Radar::getAircraftData(int id) { //done
-	//Coen320_Lab (Task0): You need to correct the channel name
-	//It is your group name + plane id
-
-	std::string id_str = "AH_40247851_40228573_"+std::to_string(id);  // Convert integer id to string
-	const char* ID = id_str.c_str();         // Convert string to const char*
-	int plane_channel = name_open(ID, 0);
+msg_plane_info Radar::getAircraftData(int id, std::chrono::steady_clock::time_point deadline) { //done
+	// Reuse the cached connection; name_open only happens on a cache miss
+	int plane_channel = getPlaneConnection(id);
 
 	if (plane_channel == -1) {
 		throw std::runtime_error("Radar: Error occurred while attaching to channel");
@@ -155,23 +298,109 @@ msg_plane_info Radar::getAircraftData(int id) { //done
 	requestMsg.data = NULL;
 
 	// Structure to hold the received position data
-	Message receiveMessage;
+	Message_position_reply receiveMessage;
+
+	// Don't let one slow aircraft hold the sweep past its deadline
+	auto remaining = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - std::chrono::steady_clock::now());
+	uint64_t timeout = std::max<int64_t>(remaining.count(), 1);
+	TimerTimeout(CLOCK_MONOTONIC, _NTO_TIMEOUT_SEND | _NTO_TIMEOUT_REPLY, NULL, &timeout, NULL);
 
 	// Send the position request to the aircraft and receive the response
 	if (MsgSend(plane_channel, &requestMsg, sizeof(requestMsg), &receiveMessage, sizeof(receiveMessage)) == -1) {
-		name_close(plane_channel);
+		if (errno == ETIMEDOUT) {
+			throw SweepDeadlineMissed("Radar: Aircraft missed the sweep deadline");
+		}
+		// The aircraft went away; drop the stale coid so the next sweep reopens it
+		closePlaneConnection(id);
 		throw std::runtime_error("Radar: Error occurred while sending request message to aircraft");
 	}
 
-	msg_plane_info received_info = *static_cast<msg_plane_info*>(receiveMessage.data);
+	msg_plane_info received_info = receiveMessage.info;
 
-	// Close the communication channel with the aircraft
-	name_close(plane_channel);
+	// A coid closed on EXIT_AIRSPACE can be reused for another plane mid-sweep
+	if (received_info.id != id) {
+		closePlaneConnection(id);
+		throw std::runtime_error("Radar: Reply came from a different aircraft");
+	}
 
 	return received_info;
 }
 
+int Radar::openPlaneConnection(int id) {
+	//Coen320_Lab (Task0): You need to correct the channel name
+	//It is your group name + plane id
+	std::string id_str = "AH_40247851_40228573_"+std::to_string(id);  // Convert integer id to string
+	return name_open(id_str.c_str(), 0);
+}
+
+int Radar::getPlaneConnection(int id) {
+	{
+		std::lock_guard<std::mutex> lock(connectionMutex);
+		auto it = planeConnections.find(id);
+		if (it != planeConnections.end()) {
+			connectionCacheHits++;
+			return it->second;
+		}
+	}
+
+	connectionCacheMisses++;
+	int plane_channel = openPlaneConnection(id);
+	if (plane_channel == -1) {
+		return -1;
+	}
+
+	std::lock_guard<std::mutex> lock(connectionMutex);
+	auto inserted = planeConnections.emplace(id, plane_channel);
+	if (!inserted.second) {
+		// Another thread cached one first; keep that and drop ours
+		name_close(plane_channel);
+	}
+	return inserted.first->second;
+}
+
+void Radar::closePlaneConnection(int id) {
+	int plane_channel = -1;
+	{
+		std::lock_guard<std::mutex> lock(connectionMutex);
+		auto it = planeConnections.find(id);
+		if (it == planeConnections.end()) {
+			return;
+		}
+		plane_channel = it->second;
+		planeConnections.erase(it);
+	}
+	name_close(plane_channel);
+}
+
+void Radar::closeAllPlaneConnections() {
+	std::lock_guard<std::mutex> lock(connectionMutex);
+	for (const auto& connection : planeConnections) {
+		name_close(connection.second);
+	}
+	planeConnections.clear();
+}
+
+uint64_t Radar::getConnectionCacheHits() const {
+	return connectionCacheHits.load();
+}
+
+uint64_t Radar::getConnectionCacheMisses() const {
+	return connectionCacheMisses.load();
+}
+
 void Radar::addPlaneToAirspace(Message msg) {
+	// Open the aircraft's connection now so the first sweep already hits the cache.
+	// If the plane is not reachable yet, the first sweep opens it instead. Push mode
+	// never polls, and batched aircraft have no channel to open.
+	int plane_channel = positionTable ? -1 : openPlaneConnection(msg.planeID);
+	if (plane_channel != -1) {
+		std::lock_guard<std::mutex> lock(connectionMutex);
+		auto inserted = planeConnections.emplace(msg.planeID, plane_channel);
+		if (!inserted.second) {
+			name_close(plane_channel);
+		}
+	}
+
 	std::lock_guard<std::mutex> lock(airspaceMutex);
 	int plane_data = msg.planeID;
     planesInAirspace.insert(plane_data);
@@ -179,136 +408,25 @@ void Radar::addPlaneToAirspace(Message msg) {
 }
 
 void Radar::removePlaneFromAirspace(int planeID) {
-	std::lock_guard<std::mutex> lock(airspaceMutex);
-	planesInAirspace.erase(planeID);  // Directly remove the integer from the list
+	{
+		std::lock_guard<std::mutex> lock(airspaceMutex);
+		planesInAirspace.erase(planeID);  // Directly remove the integer from the list
+	}
+	closePlaneConnection(planeID);
 	std::cout << "Plane " << planeID << " removed from airspace" << std::endl;
 }
 
 
-void Radar::writeToSharedMemory() {//done
-	// COEN320 Lab4_5 Task 2.1
-	/*
-	You need to implement the shared memory writing process here
-	Save SharedMemory structure to shared memory
-	Make sure to use mutex to protect the buffer switching process (e.g., bufferSwitchMutex)
-	To store aircraft data, use inactiveBuffer which is obtained from getActiveBuffer() method
-	Check the code snippet below for reference
-	at the end you need to unmap the shared memory and close the file descriptor
-	e.g., munmap(<SharedMemory object, shared_mem>, SHARED_MEMORY_SIZE) and close(shm_fd)
-
+// Publishes the active buffer as one frame. The writer grows the segment when
+// the frame does not fit and holds the seqlock odd while copying.
+void Radar::writeToSharedMemory() {
+	// Lock the buffer switching mutex
+	std::lock_guard<std::mutex> lock(bufferSwitchMutex);
 
 	// Get the active buffer based on the current active index
-    std::vector<msg_plane_info>& activeBuffer = getActiveBuffer();
-    // Get the current timestamp
-    shared_mem->timestamp = tick_counter_ref;
-
-	*/
-	// Open shared memory object
-	    shm_fd = shm_open("/tmp/AH_40247851_40228573_Radar_shm", O_CREAT | O_RDWR, 0666);
-	    if (shm_fd == -1) {
-	        std::cerr << "Failed to open shared memory" << std::endl;
-	        return;
-	    }
-
-	    // Set the size of the shared memory
-	    if (ftruncate(shm_fd, SHARED_MEMORY_SIZE) == -1) {
-	        std::cerr << "Failed to set shared memory size" << std::endl;
-	        close(shm_fd);
-	        return;
-	    }
-
-	    // Map the shared memory into the process address space
-	    SharedMemory* shared_mem = (SharedMemory*)mmap(NULL, SHARED_MEMORY_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
-	    if (shared_mem == MAP_FAILED) {
-	        std::cerr << "Failed to map shared memory" << std::endl;
-	        close(shm_fd);
-	        return;
-	    }
-
-	    // Lock the buffer switching mutex
-	    std::lock_guard<std::mutex> lock(bufferSwitchMutex);
-
-	    // Get the active buffer based on the current active index
-	    std::vector<msg_plane_info>& activeBuffer = getActiveBuffer();
-
-	    // Get the current timestamp
-	    shared_mem->timestamp = tick_counter_ref;
-
-	    // Check if activeBuffer is empty and set the flag accordingly
-	    if (activeBuffer.empty()) {
-	        std::vector<msg_plane_info>& inactiveBuffer = planesInAirspaceData[(activeBufferIndex + 1) % 2];
-	        if (!inactiveBuffer.empty()){
-	            shared_mem->is_empty.store(false);
-	            shared_mem->count = inactiveBuffer.size();
-	            std::memcpy(shared_mem->plane_data, inactiveBuffer.data(), inactiveBuffer.size() * sizeof(msg_plane_info));
-	            inactiveBuffer.clear();
-	        } else {
-	            shared_mem->is_empty.store(true);
-	            shared_mem->count = 0;  // No planes
-	        }
-	    } else {
-	        shared_mem->is_empty.store(false);
-	        shared_mem->count = activeBuffer.size();
-	        std::memcpy(shared_mem->plane_data, activeBuffer.data(), activeBuffer.size() * sizeof(msg_plane_info));
-	        activeBuffer.clear();
-	    }
-
-	    //unmap and close
-	    munmap(shared_mem, SHARED_MEMORY_SIZE);
-	    close(shm_fd);
-	
+	airspaceWriter.publish(getActiveBuffer(), tick_counter_ref);
 }
 
-void Radar::clearSharedMemory() { //done
-	// COEN320 Lab4_5 Task 2.2
-	// You need to implement the shared memory clearing process here
-	// Initialize the shared memory structure to an empty state
-	// You need to clear plane_data, count, etc.
-	// e.g.
-	//std::memset(sharedMemPtr->plane_data, 0, sizeof(sharedMemPtr->plane_data));  // Clear plane data
-	//sharedMemPtr->count = 0;  // No planes initially
-	//sharedMemPtr->is_empty.store(true);  // Set the is_empty flag to false to not block reader
-	// Finally unmap the shared memory and close the file descriptor
-	// COEN320 Lab4_5 Task 2.2
-
-	    // Open the shared memory object
-	    shm_fd = shm_open("/tmp/AH_40247851_40228573_Radar_shm", O_RDWR, 0666);
-	    if (shm_fd == -1) {
-	        std::cerr << "Failed to open shared memory for clearing" << std::endl;
-	        return;
-	    }
-
-	    // Set the size of the shared memory
-	    if (ftruncate(shm_fd, SHARED_MEMORY_SIZE) == -1) {
-	        std::cerr << "Failed to set shared memory size" << std::endl;
-	        close(shm_fd);
-	        return;
-	    }
-
-	    // Map the shared memory into the process address space
-	    SharedMemory* sharedMemPtr = (SharedMemory*)mmap(NULL, SHARED_MEMORY_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
-	    if (sharedMemPtr == MAP_FAILED) {
-	        std::cerr << "Failed to map shared memory for clearing" << std::endl;
-	        close(shm_fd);
-	        return;
-	    }
-
-	    // Clear plane data
-	    std::memset(sharedMemPtr->plane_data, 0, sizeof(sharedMemPtr->plane_data));
-
-	    // No planes initially
-	    sharedMemPtr->count = 0;
-
-	    // Set the is_empty flag to true to not block reader
-	    sharedMemPtr->is_empty.store(true);
-
-	    // Reset timestamp
-	    sharedMemPtr->timestamp = 0;
-
-	    // Set start flag to false
-	    sharedMemPtr->start = false;
-
-	    // Unmap the shared memory and close the file
-	    munmap(sharedMemPtr, SHARED_MEMORY_SIZE);
-	    close(shm_fd);
+void Radar::clearSharedMemory() {
+	airspaceWriter.clear();
 }
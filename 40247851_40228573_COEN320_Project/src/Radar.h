@@ -4,8 +4,11 @@
 #include <atomic>  // Include to use atomic flag
 #include <iostream>
 #include <unordered_set>
+#include <unordered_map>
 #include <memory>
 #include <mutex>
+#include <condition_variable>
+#include <chrono>
 #include <thread>
 #include <string>
 #include <vector>
@@ -17,14 +20,30 @@
 #include "Aircraft.h"
 #include "Msg_structs.h"
 #include "ATCTimer.h"
-
-
-// Shared memory size
-#define SHARED_MEMORY_SIZE sizeof(SharedMemory)  // Update this based on the size of your buffer
+#include "SharedAirspace.h"
+#include "PositionTable.h"
+#include "VirtualClock.h"
+#include "WorkerPool.h"
+
+// Start-up settings for the Radar
+struct RadarConfig {
+	uint32_t sweepPeriodMs = 1000;							// Time between two sweeps
+	uint32_t historyDepth = AIRSPACE_DEFAULT_HISTORY_DEPTH;	// Sweeps kept in the shared memory ring
+	unsigned sweepWorkers = 1;								// Poller threads; 1 polls sequentially on the sweep thread
+	uint32_t sweepDeadlineMs = 900;							// Aircraft that have not answered by then are reported stale (kept below the period)
+	uint32_t keyframeInterval = AIRSPACE_DEFAULT_KEYFRAME_INTERVAL;	// Sweeps between two full keyframes
+	uint32_t frameLayout = FRAME_LAYOUT_AOS;				// How planes are laid out in published frames
+};
 
 class Radar {
 public:
-	Radar(uint64_t& tick_counter);
+	// A positionTable selects push mode: frames are read from the table the aircraft
+	// write into instead of polling each aircraft with REQUEST_POSITION
+	// tick_counter is the simulation time in milliseconds; it timestamps every frame
+	// A virtualClock replaces the sweep timer: the Radar sweeps in its stage of the tick the
+	// sweep period falls due in. It needs push mode, since polled aircraft would block their stage.
+	Radar(uint64_t& tick_counter, const RadarConfig& config = RadarConfig(), PositionTable* positionTable = nullptr,
+	      VirtualClock* virtualClock = nullptr);
     ~Radar();
 
     void ListenAirspaceArrivalAndDeparture();
@@ -34,6 +53,13 @@ public:
     void writeToSharedMemory();
     void clearSharedMemory();
 
+    // Sweep statistics, for comparing push and pull mode
+    uint64_t getSweepCount() const;
+    double getAverageSweepTime() const;  // ms
+
+    // Connection cache statistics (lookups that found / had to open a coid)
+    uint64_t getConnectionCacheHits() const;
+    uint64_t getConnectionCacheMisses() const;
 
 private:
 
@@ -46,7 +72,41 @@ private:
     void addPlaneToAirspace(Message msg);
     void removePlaneFromAirspace(int ID);
     void pollAirspace();
-    msg_plane_info getAircraftData(int id);
+    msg_plane_info getAircraftData(int id, std::chrono::steady_clock::time_point deadline);
+
+    // Parallel sweep: the ID set is split across the poller threads, each filling its
+    // own partial buffer. IDs that miss the deadline are reported with last-known data,
+    // moved along its velocity; IDs that cannot be reached at all are left out.
+    void pollSlice(unsigned index, unsigned stride);
+    RadarConfig config;
+    PositionTable* positionTable;  // nullptr in pull mode
+    VirtualClock* virtualClock;    // nullptr in real time
+    WorkerPool sweepPool;          // The poller threads; a single poller in push mode
+    uint64_t sweepCount = 0;
+    double totalSweepTime = 0;  // ms
+    double maxSweepTime = 0;    // ms
+    void recordSweepTime(double elapsed);
+    std::vector<int> sweepIds;									// IDs being polled this sweep
+    std::vector<std::vector<msg_plane_info>> partialBuffers;	// One per worker
+    std::vector<std::vector<int>> missedPlanes;					// One per worker
+    std::chrono::steady_clock::time_point sweepDeadline;
+    uint64_t sweepTime = 0;										// tick_counter when the current sweep started
+    struct PlaneSample {
+    	msg_plane_info info;
+    	uint64_t time;		// sweepTime of the sweep that read it
+    };
+    std::unordered_map<int, PlaneSample> lastKnownData;			// Touched by the sweep thread only
+
+    // Persistent coids to each aircraft's channel, keyed by plane ID. Opened on
+    // ENTER_AIRSPACE, dropped on EXIT_AIRSPACE or when a send fails.
+    int openPlaneConnection(int id);
+    int getPlaneConnection(int id);
+    void closePlaneConnection(int id);
+    void closeAllPlaneConnections();
+    std::unordered_map<int, int> planeConnections;
+    std::mutex connectionMutex;
+    std::atomic<uint64_t> connectionCacheHits;
+    std::atomic<uint64_t> connectionCacheMisses;
 
     name_attach_t* Radar_channel;
 
@@ -61,10 +121,9 @@ private:
 
     ATCTimer timer;
 
-    // Shared memory pointer
-    SharedMemory* sharedMemPtr;  // Update pointer type to match the structure
+    // Shared memory segment, mapped in the constructor and unmapped in the destructor
+    AirspaceWriter airspaceWriter;
     bool wasAirspaceEmpty = true;  // Track if airspace was empty last time
-    int shm_fd = -1;
     std::atomic<bool> stopThreads;
 
     void shutdown();
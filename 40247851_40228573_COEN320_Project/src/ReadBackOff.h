@@ -0,0 +1,33 @@
+/*
+ * Back-off of the seqlock readers of the shared memory segments.
+ *
+ * A reader that finds the writer mid-update yields for the first few
+ * attempts, then sleeps a millisecond between them and gives up after the
+ * last, so a writer that died mid-update makes reads fail instead of hanging
+ * the reader.
+ */
+
+#ifndef READBACKOFF_H_
+#define READBACKOFF_H_
+
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+const uint32_t READ_YIELD_ATTEMPTS = 16;
+const uint32_t READ_ATTEMPTS = 64;
+
+// Waits before the next read attempt; false once the reader should give up
+inline bool backOff(uint32_t& attempt) {
+	if (++attempt >= READ_ATTEMPTS) {
+		return false;
+	}
+	if (attempt < READ_YIELD_ATTEMPTS) {
+		std::this_thread::yield();
+	} else {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	return true;
+}
+
+#endif /* READBACKOFF_H_ */
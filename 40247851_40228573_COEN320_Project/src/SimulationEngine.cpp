@@ -0,0 +1,316 @@
+#include "SimulationEngine.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <cerrno>
+#include <memory>
+#include "ATCTimer.h"
+
+namespace {
+
+// Rows moved before they are published, so the movement loop stays in cache
+const uint32_t STEP_CHUNK = 256;
+
+}
+
+SimulationEngine::SimulationEngine(PositionTable& table, uint32_t step, unsigned workerThreads, VirtualClock* clock)
+	: positionTable(table), stepMs(std::max(step, 1u)), workerCount(std::max(workerThreads, 1u)), virtualClock(clock), radarConnection(-1),
+	  nextArrival(0), commandChannel(NULL), stepCount(0), totalStepTime(0), maxStepTime(0), stopping(false), pool(workerCount) {
+	exitBuffers.resize(workerCount);
+
+	// Attached up front so commands can be forwarded as soon as the first aircraft arrives
+	commandChannel = name_attach(NULL, SIMULATION_CHANNEL_NAME, 0);
+	if (commandChannel == NULL) {
+		std::cerr << "Simulation: failed to create command channel, operator commands will not reach the aircraft" << std::endl;
+	} else {
+		// The listener gets the chid rather than the channel, which name_detach frees under it
+		commandListener = std::thread(&SimulationEngine::listenCommands, this, commandChannel->chid);
+	}
+}
+
+SimulationEngine::~SimulationEngine() {
+	stopping.store(true);
+	if (commandChannel) {
+		name_detach(commandChannel, 0);
+	}
+	if (commandListener.joinable()) {
+		commandListener.join();
+	}
+	if (radarConnection != -1) {
+		name_close(radarConnection);
+	}
+}
+
+void SimulationEngine::addAircraft(int planeId, double px, double py, double pz, double sx, double sy, double sz,
+								   int arrivalTime) {
+	Arrival arrival;
+	arrival.time = static_cast<uint64_t>(std::max(arrivalTime, 0)) * 1000;
+	arrival.state = {planeId, 0, px, py, pz, sx, sy, sz};
+	arrivals.push_back(arrival);
+}
+
+void SimulationEngine::run() {
+	// Ties keep the order the aircraft were added in, as their threads would have raced
+	std::stable_sort(arrivals.begin(), arrivals.end(),
+					 [](const Arrival& a, const Arrival& b) { return a.time < b.time; });
+	nextArrival = 0;
+
+	if ((radarConnection = name_open("AH_40247851_40228573_Radar", 0)) == -1) {
+		perror("Simulation: error occurred while creating the channel with Radar");
+		return;
+	}
+
+	std::unique_ptr<ClockParticipant> participant;
+	std::unique_ptr<ATCTimer> timer;
+	if (virtualClock) {
+		participant.reset(new ClockParticipant(*virtualClock, CLOCK_STAGE_AIRCRAFT));
+	} else {
+		timer.reset(new ATCTimer(stepMs / 1000, stepMs % 1000));
+	}
+	uint64_t currentTime = 0;  // Elapsed time in ms
+	bool stopped = participant && !participant->waitTurn();
+	while (!stopped && (nextArrival < arrivals.size() || !id.empty())) {
+		auto start = std::chrono::steady_clock::now();
+		applyCommands();
+		admitArrivals(currentTime);
+		if (!id.empty()) {
+			pool.run([this](unsigned index) { advance(index); });
+			removeExited();
+		}
+		double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		stepCount++;
+		totalStepTime += elapsed;
+		maxStepTime = std::max(maxStepTime, elapsed);
+
+		if (participant) {
+			participant->complete();
+			stopped = !participant->waitTurn();
+		} else {
+			timer->waitTimer();
+		}
+		currentTime += stepMs;
+	}
+
+	std::cout << "Simulation: " << stepCount << " steps on " << workerCount << " worker(s), average "
+			  << getAverageStepTime() << " ms, max " << maxStepTime << " ms" << std::endl;
+}
+
+// Aircraft whose arrival time has come claim their slot, then announce themselves
+void SimulationEngine::admitArrivals(uint64_t now) {
+	for (; nextArrival < arrivals.size() && arrivals[nextArrival].time <= now; ++nextArrival) {
+		const msg_plane_info& state = arrivals[nextArrival].state;
+		if (rowOf.count(state.id)) {
+			std::cerr << "Simulation: aircraft " << state.id << " is already flying, second arrival dropped" << std::endl;
+			continue;
+		}
+
+		int tableSlot = positionTable.acquireSlot(state);
+		if (tableSlot == -1) {
+			std::cerr << "Aircraft " << state.id << ": position table full\n";
+		}
+
+		rowOf[state.id] = id.size();
+		id.push_back(state.id);
+		maneuvers.push_back(0);
+		slot.push_back(tableSlot);
+		x.push_back(state.PositionX);
+		y.push_back(state.PositionY);
+		z.push_back(state.PositionZ);
+		vx.push_back(state.VelocityX);
+		vy.push_back(state.VelocityY);
+		vz.push_back(state.VelocityZ);
+		exited.push_back(0);
+
+		sendToRadar(MessageType::ENTER_AIRSPACE, state.id);
+	}
+}
+
+// Moves this worker's share of the rows one step, checks the bounds and publishes
+// the ones still inside
+void SimulationEngine::advance(unsigned index) {
+	uint32_t count = id.size();
+	uint32_t share = (count + workerCount - 1) / workerCount;
+	uint32_t begin = std::min(index * share, count);
+	uint32_t end = std::min(begin + share, count);
+	std::vector<uint32_t>& exits = exitBuffers[index];
+	exits.clear();
+
+	const double dt = stepMs / 1000.0;
+	const double lowX = DEFAULT_AIRSPACE.lower_x_boundary, highX = DEFAULT_AIRSPACE.upper_x_boundary;
+	const double lowY = DEFAULT_AIRSPACE.lower_y_boundary, highY = DEFAULT_AIRSPACE.upper_y_boundary;
+	const double lowZ = DEFAULT_AIRSPACE.lower_z_boundary, highZ = DEFAULT_AIRSPACE.upper_z_boundary;
+	double* __restrict px = x.data();
+	double* __restrict py = y.data();
+	double* __restrict pz = z.data();
+	const double* __restrict pvx = vx.data();
+	const double* __restrict pvy = vy.data();
+	const double* __restrict pvz = vz.data();
+	uint8_t* __restrict out = exited.data();
+
+	for (uint32_t first = begin; first < end; first += STEP_CHUNK) {
+		uint32_t last = std::min(first + STEP_CHUNK, end);
+		for (uint32_t i = first; i < last; ++i) {
+			px[i] += pvx[i] * dt;
+			py[i] += pvy[i] * dt;
+			pz[i] += pvz[i] * dt;
+			out[i] = (px[i] < lowX) | (px[i] > highX) | (py[i] < lowY) | (py[i] > highY) | (pz[i] < lowZ) | (pz[i] > highZ);
+		}
+		for (uint32_t i = first; i < last; ++i) {
+			if (out[i]) {
+				exits.push_back(i);
+			} else {
+				positionTable.update(slot[i], rowState(i));
+			}
+		}
+	}
+}
+
+// Rows are removed from the highest down, each replaced by the last row, which by
+// then is still flying
+void SimulationEngine::removeExited() {
+	for (auto buffer = exitBuffers.rbegin(); buffer != exitBuffers.rend(); ++buffer) {
+		for (auto row = buffer->rbegin(); row != buffer->rend(); ++row) {
+			uint32_t i = *row;
+			int planeId = id[i];
+			std::cout << "Aircraft " << planeId << " exiting airspace\n";
+			positionTable.releaseSlot(slot[i]);
+			rowOf.erase(planeId);
+
+			uint32_t lastRow = id.size() - 1;
+			if (i != lastRow) {
+				id[i] = id[lastRow];
+				maneuvers[i] = maneuvers[lastRow];
+				slot[i] = slot[lastRow];
+				x[i] = x[lastRow];
+				y[i] = y[lastRow];
+				z[i] = z[lastRow];
+				vx[i] = vx[lastRow];
+				vy[i] = vy[lastRow];
+				vz[i] = vz[lastRow];
+				exited[i] = exited[lastRow];
+				rowOf[id[i]] = i;
+			}
+			id.pop_back();
+			maneuvers.pop_back();
+			slot.pop_back();
+			x.pop_back();
+			y.pop_back();
+			z.pop_back();
+			vx.pop_back();
+			vy.pop_back();
+			vz.pop_back();
+			exited.pop_back();
+
+			sendToRadar(MessageType::EXIT_AIRSPACE, planeId);
+		}
+	}
+}
+
+void SimulationEngine::sendToRadar(MessageType type, int planeId) {
+	Message msg;
+	msg.type = type;
+	msg.planeID = planeId;
+	msg.data = NULL;
+	msg.dataSize = 0;
+	if (MsgSend(radarConnection, &msg, sizeof(msg), 0, 0) == -1) {
+		std::cout << "Failed to send " << (type == MessageType::ENTER_AIRSPACE ? "enter" : "exit")
+				  << " message for aircraft " << planeId << " to Radar!\n";
+	}
+}
+
+msg_plane_info SimulationEngine::rowState(uint32_t row) const {
+	// The maneuver count lets the Radar tell a commanded change from ordinary motion
+	msg_plane_info info = {id[row], maneuvers[row] << PLANE_INFO_MANEUVER_SHIFT, x[row], y[row], z[row],
+						   vx[row], vy[row], vz[row]};
+	return info;
+}
+
+// Queues the operator commands forwarded by the CommunicationsSystem
+void SimulationEngine::listenCommands(int chid) {
+	while (!stopping.load()) {
+		Message_inter_process msg;
+		memset(&msg, 0, sizeof(msg));
+		int rcvid = MsgReceive(chid, &msg, sizeof(msg), NULL);
+		if (rcvid == -1) {
+			continue;
+		}
+		// Skip pulses
+		if (rcvid == 0) {
+			continue;
+		}
+
+		switch (msg.type) {
+		case MessageType::REQUEST_CHANGE_OF_HEADING:
+		case MessageType::REQUEST_CHANGE_POSITION:
+		case MessageType::REQUEST_CHANGE_ALTITUDE: {
+			std::lock_guard<std::mutex> lock(commandMutex);
+			commands.push_back(msg);
+			MsgReply(rcvid, 0, NULL, 0);
+			break;
+		}
+		default:
+			std::cerr << "Simulation received unknown message type: " << static_cast<int>(msg.type) << "\n";
+			MsgError(rcvid, ENOSYS);
+			break;
+		}
+	}
+}
+
+// Applies the queued commands the way Aircraft::updatePosition does
+void SimulationEngine::applyCommands() {
+	std::vector<Message_inter_process> pending;
+	{
+		std::lock_guard<std::mutex> lock(commandMutex);
+		pending.swap(commands);
+	}
+
+	for (Message_inter_process& msg : pending) {
+		auto row = rowOf.find(msg.planeID);
+		if (row == rowOf.end()) {
+			std::cerr << "Simulation: aircraft " << msg.planeID << " is not in the airspace, command dropped\n";
+			continue;
+		}
+		uint32_t i = row->second;
+
+		switch (msg.type) {
+		case MessageType::REQUEST_CHANGE_OF_HEADING: {
+			const msg_change_heading* heading = reinterpret_cast<const msg_change_heading*>(msg.data.data());
+			if (heading->VelocityX != 0) vx[i] = heading->VelocityX;
+			if (heading->VelocityY != 0) vy[i] = heading->VelocityY;
+			if (heading->VelocityZ != 0) vz[i] = heading->VelocityZ;
+			std::cout << "Aircraft " << msg.planeID << " heading changed to: VX=" << vx[i] << " VY=" << vy[i]
+					  << " VZ=" << vz[i] << "\n";
+			break;
+		}
+		case MessageType::REQUEST_CHANGE_POSITION: {
+			const msg_change_position* position = reinterpret_cast<const msg_change_position*>(msg.data.data());
+			x[i] = position->x;
+			y[i] = position->y;
+			z[i] = position->z;
+			std::cout << "Aircraft " << msg.planeID << " position updated\n";
+			break;
+		}
+		case MessageType::REQUEST_CHANGE_ALTITUDE: {
+			const msg_change_heading* altitude = reinterpret_cast<const msg_change_heading*>(msg.data.data());
+			z[i] = altitude->altitude;
+			std::cout << "Aircraft " << msg.planeID << " altitude updated to " << z[i] << "\n";
+			break;
+		}
+		default:
+			continue;
+		}
+		maneuvers[i]++;
+	}
+}
+
+uint64_t SimulationEngine::getStepCount() const {
+	return stepCount;
+}
+
+double SimulationEngine::getAverageStepTime() const {
+	return stepCount ? totalStepTime / stepCount : 0;
+}
+
+double SimulationEngine::getMaxStepTime() const {
+	return maxStepTime;
+}
@@ -0,0 +1,115 @@
+/*
+ * Batched aircraft simulation: the state of every aircraft in one set of
+ * columns, advanced together once per step on a small fixed pool of threads.
+ *
+ * The per-aircraft model (Aircraft) runs a thread, a timer and a channel for
+ * every aircraft. Here a single timer drives the steps. Aircraft wait in
+ * arrival order until their arrival time, then join the flying rows. Each step
+ * moves all rows with one loop over the position and velocity columns, checks
+ * them against the airspace bounds in the same loop, and publishes them to the
+ * PositionTable. Rows that left the airspace are removed after the step, and
+ * ENTER_AIRSPACE / EXIT_AIRSPACE reach the Radar exactly as from an Aircraft.
+ *
+ * With no channel per aircraft the Radar has to run in push mode. Operator
+ * commands come in on SIMULATION_CHANNEL_NAME, where the CommunicationsSystem
+ * sends them first. Commands are queued and applied before the next step, so
+ * the columns are only ever written by the step.
+ *
+ * With a VirtualClock the engine is the aircraft stage: each tick is one step.
+ */
+
+#ifndef SIMULATIONENGINE_H_
+#define SIMULATIONENGINE_H_
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <sys/dispatch.h>
+#include "Aircraft.h"
+#include "Msg_structs.h"
+#include "PositionTable.h"
+#include "VirtualClock.h"
+#include "WorkerPool.h"
+
+#define SIMULATION_CHANNEL_NAME "AH_40247851_40228573_Simulation"
+
+// How the aircraft are simulated
+enum SimulationModel {
+	SIMULATION_THREAD_PER_AIRCRAFT,	// One Aircraft object and thread each
+	SIMULATION_BATCHED				// All of them in a SimulationEngine
+};
+
+class SimulationEngine {
+public:
+	// stepMs is the simulation step; speeds are per second and scaled by it
+	// A virtualClock paces the steps instead of a timer
+	SimulationEngine(PositionTable& positionTable, uint32_t stepMs = 1000, unsigned workers = 1, VirtualClock* virtualClock = nullptr);
+	~SimulationEngine();
+
+	// Schedule an aircraft to enter the airspace `arrivalTime` seconds after run() starts
+	void addAircraft(int id, double x, double y, double z, double sx, double sy, double sz, int arrivalTime);
+
+	// Step until every aircraft has arrived and left the airspace, or the virtual clock stops
+	void run();
+
+	// Step statistics
+	uint64_t getStepCount() const;
+	double getAverageStepTime() const;  // ms
+	double getMaxStepTime() const;      // ms
+
+private:
+	struct Arrival {
+		uint64_t time;			// ms
+		msg_plane_info state;
+	};
+
+	void listenCommands(int chid);
+	void applyCommands();
+	void admitArrivals(uint64_t now);
+	void removeExited();
+	void sendToRadar(MessageType type, int id);
+	msg_plane_info rowState(uint32_t row) const;
+
+	void advance(unsigned index);
+
+	PositionTable& positionTable;
+	uint32_t stepMs;
+	unsigned workerCount;
+	VirtualClock* virtualClock;			// nullptr in real time
+	int radarConnection;
+
+	std::vector<Arrival> arrivals;		// Sorted by time once run() starts
+	size_t nextArrival;
+
+	// Flying aircraft, one row each
+	std::vector<int> id;
+	std::vector<int> maneuvers;			// Commands applied so far
+	std::vector<int> slot;				// In positionTable
+	std::vector<double> x, y, z;
+	std::vector<double> vx, vy, vz;
+	std::vector<uint8_t> exited;		// Set by the step for rows past the bounds
+	std::unordered_map<int, uint32_t> rowOf;
+
+	// Rows that left during the step, one list per worker
+	std::vector<std::vector<uint32_t>> exitBuffers;
+
+	// Commands received since the last step
+	std::vector<Message_inter_process> commands;
+	std::mutex commandMutex;
+	std::thread commandListener;
+	name_attach_t* commandChannel;
+
+	uint64_t stepCount;
+	double totalStepTime;
+	double maxStepTime;
+
+	std::atomic<bool> stopping;
+
+	// Last, so that its threads are joined before the rows they step go away
+	WorkerPool pool;
+};
+
+#endif /* SIMULATIONENGINE_H_ */
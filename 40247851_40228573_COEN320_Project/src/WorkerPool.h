@@ -0,0 +1,50 @@
+/*
+ * Fixed pool of worker threads that run one job at a time.
+ *
+ * run() hands the job to every worker, each calling it with its own index,
+ * and returns once all of them are done with it. The threads are started once
+ * and wait between jobs, so a job costs a wake-up rather than a thread start.
+ * With a single worker the job runs on the calling thread and no thread is
+ * started at all.
+ */
+
+#ifndef WORKERPOOL_H_
+#define WORKERPOOL_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class WorkerPool {
+public:
+	explicit WorkerPool(unsigned workers = 1);
+	~WorkerPool();
+
+	WorkerPool(const WorkerPool&) = delete;
+	WorkerPool& operator=(const WorkerPool&) = delete;
+
+	// Calls job(index) for every index below size(), each on its own worker, and
+	// waits for all of them. Only one thread may call run() at a time.
+	void run(const std::function<void(unsigned)>& job);
+
+	unsigned size() const;
+
+private:
+	void worker(unsigned index);
+
+	unsigned workerCount;
+	std::vector<std::thread> threads;	// Empty with a single worker
+
+	std::mutex mutex;
+	std::condition_variable start;
+	std::condition_variable done;
+	const std::function<void(unsigned)>* job = nullptr;	// The job of the current round
+	uint64_t generation = 0;
+	unsigned pending = 0;
+	bool stopping = false;
+};
+
+#endif /* WORKERPOOL_H_ */
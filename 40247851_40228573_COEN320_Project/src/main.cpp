@@ -1,37 +1,139 @@
 #include "AirTrafficControl.h"
 #include "Radar.h"
 #include "ATCTimer.h"
+#include "VirtualClock.h"
 
 // Global tick counter
-uint64_t tick_counter = 0; // Counter for time ticks
+uint64_t tick_counter = 0; // Simulation time in ms
 std::atomic<bool> running(true);  // Flag to control the timer thread
 
-// Function to increment the tick_counter every second
-void timer_tick() {
+// Function to advance the tick_counter once per simulation step
+void timer_tick(uint32_t stepMs) {
+    auto start = std::chrono::steady_clock::now();
     while (running) {
-        std::this_thread::sleep_for(std::chrono::seconds(1));  // Sleep for 1 second
-        tick_counter++;  // Increment the tick counter
+        std::this_thread::sleep_for(std::chrono::milliseconds(stepMs));  // Sleep for one step
+        // Read the clock rather than adding stepMs so oversleeping does not accumulate
+        tick_counter = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
         //std::cout << "Tick counter: " << tick_counter << std::endl;  // Optionally print it
     }
 }
 
+// Virtual clock: runs the ticks instead of timer_tick, each one once every stage has finished the last
+void clock_tick(VirtualClock* virtualClock, std::vector<ClockStage> awaitedStages) {
+    // Tick 1 waits for the stages that have to see the whole run
+    for (ClockStage stage : awaitedStages) {
+        virtualClock->waitForStage(stage);
+    }
+    auto start = std::chrono::steady_clock::now();
+    while (running) {
+        tick_counter = (virtualClock->getTick() + 1) * virtualClock->getStepMs();
+        virtualClock->startTick();
+        virtualClock->waitTickDone();
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Virtual clock: " << virtualClock->getTick() << " ticks, " << tick_counter / 1000.0
+              << " s simulated in " << elapsed << " s" << std::endl;
+}
+
+
+int main(int argc, char* argv[]) {
+    // Optional settings: --step-ms <ms> --sweep-ms <ms> --sweep-workers <n> --sweep-deadline-ms <ms>
+    //                    --history-depth <frames> --keyframe-interval <frames> --frame-layout <aos|soa>
+    //                    --position-mode <pull|push> --simulation <threads|batched> --simulation-workers <n>
+    //                    --clock <realtime|scaled|lockstep> --clock-speed <x> --clock-await <computer|display>
+    RadarConfig radarConfig;
+    uint32_t stepMs = 1000;
+    bool pushMode = false;
+    SimulationModel simulationModel = SIMULATION_THREAD_PER_AIRCRAFT;
+    unsigned simulationWorkers = 1;
+    ClockMode clockMode = CLOCK_MODE_REALTIME;
+    double clockSpeed = 1;
+    std::vector<ClockStage> awaitedStages = {CLOCK_STAGE_AIRCRAFT, CLOCK_STAGE_RADAR};
+    for (int i = 1; i < argc; i += 2) {
+        std::string option = argv[i];
+        // A trailing option without its value is as wrong as an unknown one
+        if (i + 1 == argc) {
+            std::cerr << "Unknown option: " << option << " (no value)" << std::endl;
+            return EXIT_FAILURE;
+        }
+        std::string value = argv[i + 1];
+        if (option == "--step-ms") {
+            stepMs = std::max<uint32_t>(std::stoul(value), 1);
+        } else if (option == "--sweep-ms") {
+            radarConfig.sweepPeriodMs = std::stoul(value);
+        } else if (option == "--sweep-workers") {
+            radarConfig.sweepWorkers = std::stoul(value);
+        } else if (option == "--sweep-deadline-ms") {
+            radarConfig.sweepDeadlineMs = std::stoul(value);
+        } else if (option == "--history-depth") {
+            radarConfig.historyDepth = std::stoul(value);
+        } else if (option == "--keyframe-interval") {
+            radarConfig.keyframeInterval = std::stoul(value);
+        } else if (option == "--frame-layout" && (value == "aos" || value == "soa")) {
+            radarConfig.frameLayout = (value == "soa") ? FRAME_LAYOUT_SOA : FRAME_LAYOUT_AOS;
+        } else if (option == "--position-mode" && (value == "pull" || value == "push")) {
+            pushMode = (value == "push");
+        } else if (option == "--simulation" && (value == "threads" || value == "batched")) {
+            simulationModel = (value == "batched") ? SIMULATION_BATCHED : SIMULATION_THREAD_PER_AIRCRAFT;
+        } else if (option == "--simulation-workers") {
+            simulationWorkers = std::max<unsigned>(std::stoul(value), 1);
+        } else if (option == "--clock" && (value == "realtime" || value == "scaled" || value == "lockstep")) {
+            clockMode = (value == "realtime") ? CLOCK_MODE_REALTIME : (value == "scaled") ? CLOCK_MODE_SCALED : CLOCK_MODE_LOCKSTEP;
+        } else if (option == "--clock-speed") {
+            clockSpeed = std::stod(value);
+        } else if (option == "--clock-await" && (value == "computer" || value == "display")) {
+            // Repeatable; the ComputerSystem and Display join whenever they are started otherwise
+            awaitedStages.push_back((value == "computer") ? CLOCK_STAGE_COMPUTER : CLOCK_STAGE_DISPLAY);
+        } else {
+            std::cerr << "Unknown option: " << option << " " << value << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Batched aircraft have no channels to poll, so they always report in push mode
+    if (simulationModel == SIMULATION_BATCHED && !pushMode) {
+        std::cout << "Batched simulation: using push mode" << std::endl;
+        pushMode = true;
+    }
+
+    // Aircraft only answer polls between their steps, which the virtual clock does not wait for
+    if (clockMode != CLOCK_MODE_REALTIME && !pushMode) {
+        std::cout << "Virtual clock: using push mode" << std::endl;
+        pushMode = true;
+    }
+
+    // Created before everything that takes part in it, and destroyed after
+    VirtualClock virtualClock;
+    VirtualClock* clock = nullptr;
+    if (clockMode != CLOCK_MODE_REALTIME) {
+        if (!virtualClock.create(clockMode, stepMs, clockSpeed)) {
+            return EXIT_FAILURE;
+        }
+        clock = &virtualClock;
+    }
+
+    // In push mode the aircraft write their state into this table and the Radar reads it
+    PositionTable positionTable;
+    PositionTable* pushTable = pushMode ? &positionTable : nullptr;
 
-int main() {
     // Create the AirTrafficControl instance
-    AirTrafficControl atc;
+    AirTrafficControl atc(pushTable, stepMs, simulationModel, simulationWorkers, clock);
 
     atc.readPlanesFromFile("/tmp/40247851_40228573_planes.txt");  // Ensure the file is in the correct directory
 
-    Radar radar(tick_counter);
+    Radar radar(tick_counter, radarConfig, pushTable, clock);
 
-    // Start a timer thread to increment tick_counter every second
-    std::thread timer_thread(timer_tick);
+    // Start a timer thread to advance tick_counter every step
+    std::thread timer_thread = clock ? std::thread(clock_tick, clock, awaitedStages) : std::thread(timer_tick, stepMs);
 
     atc.startPlanes();
 
     if (atc.areAllPlanesFinished()) {
     	std::cout << "Main function received signal that all aircraft are inactive.\n";
     	running = false;  // Stop the timer thread
+    	if (clock) {
+    		clock->stop();  // Wakes the clock thread and every stage still taking part
+    	}
     	timer_thread.join();  // Wait for the timer thread to finish
     }
     return 0;
@@ -0,0 +1,180 @@
+/*
+ * Microbenchmark of the collision narrow phase at 100, 1k and 10k aircraft.
+ *
+ * Aircraft are spread at a constant density (about one per 100 km^2) with
+ * cruise speeds, and the check is timed six ways over the same frame:
+ *   pairwise     - every pair through sweptConflict, one pair at a time
+ *   kernel       - every pair through conflictMask, a block at a time over SoA
+ *   grid+pairwise - pairs from the SpatialGrid broad phase, one at a time
+ *   engine x1, xN - CollisionEngine (grid + kernel, what ComputerSystem runs)
+ *                   on one worker and on one per hardware thread; its result
+ *                   has to be the same pairs in the same order on every run
+ *   sweep         - CollisionEngine with the incremental sweep and prune,
+ *                   fed consecutive 1 s frames so it runs in steady state
+ * Every path has to report the same conflicts.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "CollisionEngine.h"
+#include "ConflictDetection.h"
+#include "ConflictKernel.h"
+#include "SpatialGrid.h"
+
+namespace {
+
+const Separation SEPARATION = {3000, 3000, 1000};
+const double HORIZON = 180;
+const double MIN_RUN_MS = 200;	// Repeat each path for at least this long
+const uint32_t SWEEP_FRAMES = 20;	// Consecutive frames cycled through by the sweep path
+
+void makeFrame(uint32_t count, PlaneColumns& planes) {
+	std::mt19937 rng(count);
+	double side = 10000 * std::sqrt(static_cast<double>(count));
+	std::uniform_real_distribution<double> position(0, side), altitude(15000, 40000);
+	std::uniform_real_distribution<double> speed(-500, 500), climb(-20, 20);
+	planes.clear();
+	for (uint32_t i = 0; i < count; ++i) {
+		msg_plane_info plane = {static_cast<int>(i), 0, position(rng), position(rng), altitude(rng),
+								speed(rng), speed(rng), climb(rng)};
+		planes.push_back(plane);
+	}
+}
+
+size_t pairwise(const PlaneView& planes) {
+	size_t hits = 0;
+	ConflictResult result;
+	for (uint32_t i = 0; i < planes.size(); ++i) {
+		for (uint32_t j = i + 1; j < planes.size(); ++j) {
+			hits += sweptConflict(planes, i, j, SEPARATION, HORIZON, result);
+		}
+	}
+	return hits;
+}
+
+size_t kernel(const PlaneView& planes) {
+	size_t hits = 0;
+	for (uint32_t i = 0; i < planes.size(); ++i) {
+		for (uint32_t j = i + 1; j < planes.size(); j += CONFLICT_BLOCK) {
+			uint32_t count = std::min(CONFLICT_BLOCK, planes.size() - j);
+			hits += __builtin_popcount(conflictMask(planes, i, j, count, SEPARATION, HORIZON));
+		}
+	}
+	return hits;
+}
+
+size_t gridPairwise(const PlaneView& planes, SpatialGrid& grid, std::vector<std::pair<uint32_t, uint32_t>>& pairs) {
+	grid.findCandidates(planes, HORIZON, pairs);
+	size_t hits = 0;
+	ConflictResult result;
+	for (const auto& pair : pairs) {
+		hits += sweptConflict(planes, pair.first, pair.second, SEPARATION, HORIZON, result);
+	}
+	return hits;
+}
+
+size_t engine(const PlaneView& planes, CollisionEngine& engine, std::vector<msg_collision>& conflicts) {
+	engine.evaluate(planes, HORIZON, conflicts);
+	return conflicts.size();
+}
+
+// The frame `seconds` later, every aircraft on its course
+void advance(const PlaneColumns& frame, double seconds, PlaneColumns& later) {
+	later = frame;
+	for (size_t i = 0; i < later.size(); ++i) {
+		later.x[i] += later.vx[i] * seconds;
+		later.y[i] += later.vy[i] * seconds;
+		later.z[i] += later.vz[i] * seconds;
+	}
+}
+
+// Mean ms per call of `run`, which returns the conflict count
+template <typename Run>
+double measure(Run run, size_t& hits) {
+	hits = run();
+	int calls = 0;
+	auto start = std::chrono::steady_clock::now();
+	double elapsed = 0;
+	do {
+		run();
+		++calls;
+		elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	} while (elapsed < MIN_RUN_MS);
+	return elapsed / calls;
+}
+
+}
+
+int main() {
+	unsigned threads = std::max(std::thread::hardware_concurrency(), 2u);
+	std::printf("conflict kernel: %s, block of %u; engine xN uses %u workers\n", conflictKernelIsa(), CONFLICT_BLOCK,
+				threads);
+	std::printf("%8s %14s %14s %14s %14s %14s %14s %10s\n", "aircraft", "pairwise ms", "kernel ms", "grid+pair ms",
+				"engine x1 ms", "engine xN ms", "sweep ms", "conflicts");
+
+	bool consistent = true;
+	PlaneColumns frame;
+	SpatialGrid grid(SEPARATION.x, SEPARATION.y, SEPARATION.z);
+	std::vector<std::pair<uint32_t, uint32_t>> pairs;
+	CollisionEngine single(SEPARATION, 1);
+	CollisionEngine pool(SEPARATION, threads);
+	std::vector<msg_collision> conflicts, reference;
+	for (uint32_t count : {100u, 1000u, 10000u}) {
+		makeFrame(count, frame);
+		PlaneView planes = frame.view();
+
+		size_t hits[6];
+		double ms[6];
+		ms[0] = measure([&] { return pairwise(planes); }, hits[0]);
+		ms[1] = measure([&] { return kernel(planes); }, hits[1]);
+		ms[2] = measure([&] { return gridPairwise(planes, grid, pairs); }, hits[2]);
+		ms[3] = measure([&] { return engine(planes, single, reference); }, hits[3]);
+		ms[4] = measure([&] { return engine(planes, pool, conflicts); }, hits[4]);
+
+		// The sweep keeps its state between frames. The frame checked against the other paths
+		// is the first of the cycle, reached again by incremental updates.
+		CollisionEngine sweep(SEPARATION, 1, BROAD_PHASE_SWEEP);
+		std::vector<PlaneColumns> frames(SWEEP_FRAMES);
+		for (uint32_t f = 0; f < SWEEP_FRAMES; ++f) {
+			advance(frame, f, frames[f]);
+		}
+		std::vector<msg_collision> sweepConflicts;
+		uint32_t next = 0;
+		auto sweepNext = [&] {
+			size_t found = engine(frames[next].view(), sweep, sweepConflicts);
+			next = (next + 1) % SWEEP_FRAMES;
+			return found;
+		};
+		ms[5] = measure(sweepNext, hits[5]);
+		while (next != 0) {
+			sweepNext();
+		}
+		hits[5] = sweepNext();
+
+		std::printf("%8u %14.3f %14.3f %14.3f %14.3f %14.3f %14.3f %10zu\n", count, ms[0], ms[1], ms[2], ms[3], ms[4],
+					ms[5], hits[0]);
+		bool sameOrder = conflicts.size() == reference.size();
+		for (size_t k = 0; sameOrder && k < conflicts.size(); ++k) {
+			sameOrder = conflicts[k].plane1 == reference[k].plane1 && conflicts[k].plane2 == reference[k].plane2
+						&& conflicts[k].conflictTime == reference[k].conflictTime;
+		}
+		if (!sameOrder) {
+			std::printf("  engine xN differs from engine x1\n");
+			consistent = false;
+		}
+		for (int path = 1; path < 6; ++path) {
+			if (hits[path] != hits[0]) {
+				std::printf("  path %d found %zu conflicts, pairwise found %zu\n", path, hits[path], hits[0]);
+				consistent = false;
+			}
+		}
+	}
+	return consistent ? EXIT_SUCCESS : EXIT_FAILURE;
+}
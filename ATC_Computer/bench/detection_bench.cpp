@@ -0,0 +1,298 @@
+/*
+ * Benchmark suite of the collision check over reproducible traffic, for sizing
+ * the detection settings of a deployment.
+ *
+ * Four scenarios, each generated from a fixed seed at 10 to 100k aircraft:
+ *   uniform  - random positions and courses at constant density, as in conflict_bench
+ *   clustered - the same aircraft bunched around terminal areas
+ *   head-on  - opposing streams along parallel airways, on alternate flight levels
+ *   holding  - stacks of aircraft circling at 1000 ft intervals
+ * A scenario is a run of FRAMES consecutive 1 s frames. Every strategy first
+ * goes through them once to record its conflicts, which have to be the same
+ * pairs as the reference (engine grid x1) in every frame, and is then timed
+ * frame by frame for at least MIN_RUN_MS, going back and forth through them.
+ *
+ * Per strategy it reports the mean, p50 and p99 frame latency, frames per
+ * second, and the time per aircraft pair in the frame (n(n-1)/2 of them,
+ * whichever the strategy actually tests). The all-pairs strategies are skipped
+ * above ALL_PAIRS_LIMIT aircraft.
+ *
+ * Usage: detection_bench [max aircraft] [scenario...]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "CollisionEngine.h"
+#include "ConflictDetection.h"
+#include "ConflictKernel.h"
+#include "SpatialGrid.h"
+
+namespace {
+
+const Separation SEPARATION = {3000, 3000, 1000};
+const double HORIZON = 180;
+const uint32_t FRAMES = 10;				// Consecutive frames per scenario
+const double MIN_RUN_MS = 300;			// Time each strategy for at least this long
+const uint32_t ALL_PAIRS_LIMIT = 10000;	// Largest frame the all-pairs strategies run on
+
+typedef std::vector<std::pair<int, int>> PairList;
+
+enum Scenario { UNIFORM, CLUSTERED, HEAD_ON, HOLDING, SCENARIO_COUNT };
+
+const char* SCENARIO_NAMES[SCENARIO_COUNT] = {"uniform", "clustered", "head-on", "holding"};
+
+// One aircraft: a straight course from (x, y, z), or a circle of `radius`
+// around (x, y) when holding
+struct Flight {
+	double x, y, z;
+	double vx, vy, vz;
+	double radius, phase, omega;
+};
+
+void makeFlights(Scenario scenario, uint32_t count, std::vector<Flight>& flights) {
+	std::mt19937 rng(count * SCENARIO_COUNT + scenario);
+	double side = 10000 * std::sqrt(static_cast<double>(count));
+	std::uniform_real_distribution<double> position(0, side), altitude(15000, 40000);
+	std::uniform_real_distribution<double> speed(-500, 500), climb(-20, 20), unit(0, 1);
+	std::normal_distribution<double> jitter(0, 1);
+	flights.assign(count, Flight());
+
+	switch (scenario) {
+	case UNIFORM:
+		for (Flight& flight : flights) {
+			flight = {position(rng), position(rng), altitude(rng), speed(rng), speed(rng), climb(rng), 0, 0, 0};
+		}
+		break;
+
+	case CLUSTERED: {
+		// About 100 aircraft per area, within 15000 ft of its centre
+		std::vector<std::pair<double, double>> centres(std::max<uint32_t>(count / 100, 1));
+		for (auto& centre : centres) {
+			centre = std::make_pair(position(rng), position(rng));
+		}
+		std::uniform_int_distribution<size_t> area(0, centres.size() - 1);
+		for (Flight& flight : flights) {
+			const auto& centre = centres[area(rng)];
+			flight = {centre.first + 15000 * jitter(rng), centre.second + 15000 * jitter(rng), altitude(rng),
+					  speed(rng), speed(rng), climb(rng), 0, 0, 0};
+		}
+		break;
+	}
+
+	case HEAD_ON: {
+		// 100 aircraft per airway, 40000 ft in trail each way; eastbound on odd
+		// thousands, westbound on even ones
+		const uint32_t perAirway = 100;
+		const double length = perAirway / 2 * 40000.0;
+		std::uniform_real_distribution<double> along(0, length);
+		std::uniform_int_distribution<int> level(0, 4);
+		for (uint32_t i = 0; i < count; ++i) {
+			bool east = i % 2 == 0;
+			double airway = (i / perAirway) * 60000.0;
+			flights[i] = {along(rng), airway + 500 * jitter(rng), (east ? 31000 : 30000) + 2000.0 * level(rng) + 150 * jitter(rng),
+						  east ? 450.0 : -450.0, 0, 0, 0, 0, 0};
+		}
+		break;
+	}
+
+	case HOLDING: {
+		// 16 levels per stack from 7000 ft, right-hand turns at 300 ft/s
+		const uint32_t levels = 16;
+		const double radius = 12000;
+		uint32_t stacks = (count + levels - 1) / levels;
+		uint32_t columns = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(stacks))));
+		for (uint32_t i = 0; i < count; ++i) {
+			uint32_t stack = i / levels;
+			flights[i] = {(stack % columns) * 150000.0, (stack / columns) * 150000.0, 7000 + 1000.0 * (i % levels) + 100 * jitter(rng),
+						  0, 0, 0, radius, 2 * M_PI * unit(rng), -300 / radius};
+		}
+		break;
+	}
+
+	default:
+		break;
+	}
+}
+
+// The frame `second` seconds in, planes sorted by id
+void makeFrame(const std::vector<Flight>& flights, double second, PlaneColumns& planes) {
+	planes.clear();
+	planes.reserve(flights.size());
+	for (size_t i = 0; i < flights.size(); ++i) {
+		const Flight& flight = flights[i];
+		msg_plane_info plane = {static_cast<int>(i), 0, flight.x + flight.vx * second, flight.y + flight.vy * second,
+								flight.z + flight.vz * second, flight.vx, flight.vy, flight.vz};
+		if (flight.radius > 0) {
+			double angle = flight.phase + flight.omega * second;
+			plane.PositionX = flight.x + flight.radius * std::cos(angle);
+			plane.PositionY = flight.y + flight.radius * std::sin(angle);
+			plane.VelocityX = -flight.radius * flight.omega * std::sin(angle);
+			plane.VelocityY = flight.radius * flight.omega * std::cos(angle);
+		}
+		planes.push_back(plane);
+	}
+}
+
+void pairwise(const PlaneView& planes, PairList& found) {
+	ConflictResult result;
+	for (uint32_t i = 0; i < planes.size(); ++i) {
+		for (uint32_t j = i + 1; j < planes.size(); ++j) {
+			if (sweptConflict(planes, i, j, SEPARATION, HORIZON, result)) {
+				found.emplace_back(planes.id(i), planes.id(j));
+			}
+		}
+	}
+}
+
+void kernel(const PlaneView& planes, PairList& found) {
+	for (uint32_t i = 0; i < planes.size(); ++i) {
+		for (uint32_t j = i + 1; j < planes.size(); j += CONFLICT_BLOCK) {
+			uint32_t count = std::min(CONFLICT_BLOCK, planes.size() - j);
+			for (uint32_t mask = conflictMask(planes, i, j, count, SEPARATION, HORIZON); mask; mask &= mask - 1) {
+				found.emplace_back(planes.id(i), planes.id(j + __builtin_ctz(mask)));
+			}
+		}
+	}
+}
+
+void gridPairwise(const PlaneView& planes, SpatialGrid& grid, std::vector<std::pair<uint32_t, uint32_t>>& pairs,
+				  PairList& found) {
+	grid.findCandidates(planes, HORIZON, pairs);
+	ConflictResult result;
+	for (const auto& pair : pairs) {
+		if (sweptConflict(planes, pair.first, pair.second, SEPARATION, HORIZON, result)) {
+			found.emplace_back(planes.id(pair.first), planes.id(pair.second));
+		}
+	}
+	std::sort(found.begin(), found.end());
+}
+
+void engine(const PlaneView& planes, CollisionEngine& engine, std::vector<msg_collision>& conflicts, PairList& found) {
+	engine.evaluate(planes, HORIZON, conflicts);
+	for (const msg_collision& conflict : conflicts) {
+		found.emplace_back(conflict.plane1, conflict.plane2);
+	}
+}
+
+struct Strategy {
+	const char* name;
+	bool allPairs;
+	std::function<void(const PlaneView&, PairList&)> detect;
+};
+
+// Nearest-rank percentile of sorted samples
+double percentile(const std::vector<double>& sorted, double fraction) {
+	size_t rank = static_cast<size_t>(std::ceil(fraction * sorted.size()));
+	return sorted[std::min(std::max<size_t>(rank, 1), sorted.size()) - 1];
+}
+
+}
+
+int main(int argc, char* argv[]) {
+	uint32_t maxAircraft = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+	bool selected[SCENARIO_COUNT] = {argc <= 2, argc <= 2, argc <= 2, argc <= 2};
+	for (int a = 2; a < argc; ++a) {
+		for (int s = 0; s < SCENARIO_COUNT; ++s) {
+			selected[s] |= std::strcmp(argv[a], SCENARIO_NAMES[s]) == 0;
+		}
+	}
+
+	unsigned threads = std::max(std::thread::hardware_concurrency(), 2u);
+	std::printf("conflict kernel: %s, block of %u; xN uses %u workers; %u frames per scenario, horizon %.0f s\n",
+				conflictKernelIsa(), CONFLICT_BLOCK, threads, FRAMES, HORIZON);
+
+	bool consistent = true;
+	std::vector<Flight> flights;
+	std::vector<PlaneColumns> frames(FRAMES);
+	std::vector<PairList> reference(FRAMES);
+	PairList found;
+	std::vector<double> samples;
+	for (int s = 0; s < SCENARIO_COUNT; ++s) {
+		if (!selected[s]) {
+			continue;
+		}
+		for (uint32_t count : {10u, 100u, 1000u, 10000u, 100000u}) {
+			if (count > maxAircraft) {
+				continue;
+			}
+			makeFlights(static_cast<Scenario>(s), count, flights);
+			for (uint32_t f = 0; f < FRAMES; ++f) {
+				makeFrame(flights, f, frames[f]);
+			}
+
+			// Engines are made per run so the sweep starts cold
+			SpatialGrid grid(SEPARATION.x, SEPARATION.y, SEPARATION.z);
+			std::vector<std::pair<uint32_t, uint32_t>> pairs;
+			std::vector<msg_collision> conflicts;
+			CollisionEngine gridSingle(SEPARATION, 1), gridPool(SEPARATION, threads);
+			CollisionEngine sweepSingle(SEPARATION, 1, BROAD_PHASE_SWEEP), sweepPool(SEPARATION, threads, BROAD_PHASE_SWEEP);
+			Strategy strategies[] = {
+				{"engine grid x1", false, [&](const PlaneView& p, PairList& out) { engine(p, gridSingle, conflicts, out); }},
+				{"engine grid xN", false, [&](const PlaneView& p, PairList& out) { engine(p, gridPool, conflicts, out); }},
+				{"engine sweep x1", false, [&](const PlaneView& p, PairList& out) { engine(p, sweepSingle, conflicts, out); }},
+				{"engine sweep xN", false, [&](const PlaneView& p, PairList& out) { engine(p, sweepPool, conflicts, out); }},
+				{"grid+pairwise", false, [&](const PlaneView& p, PairList& out) { gridPairwise(p, grid, pairs, out); }},
+				{"kernel", true, kernel},
+				{"pairwise", true, pairwise},
+			};
+
+			size_t total = 0;
+			for (uint32_t f = 0; f < FRAMES; ++f) {
+				reference[f].clear();
+				strategies[0].detect(frames[f].view(), reference[f]);
+				total += reference[f].size();
+			}
+			double pairCount = count * (count - 1.0) / 2;
+			std::printf("\n%s, %u aircraft: %.1f conflicts per frame\n", SCENARIO_NAMES[s], count,
+						static_cast<double>(total) / FRAMES);
+			std::printf("  %-16s %12s %12s %12s %12s %10s\n", "strategy", "mean ms", "p50 ms", "p99 ms", "frames/s", "ns/pair");
+
+			for (const Strategy& strategy : strategies) {
+				if (strategy.allPairs && count > ALL_PAIRS_LIMIT) {
+					std::printf("  %-16s %12s\n", strategy.name, "skipped");
+					continue;
+				}
+
+				// Recording pass, which also brings the strategy to steady state
+				for (uint32_t f = 0; f < FRAMES; ++f) {
+					found.clear();
+					strategy.detect(frames[f].view(), found);
+					if (found != reference[f]) {
+						std::printf("  %s: frame %u has %zu conflicts, reference has %zu or different pairs\n", strategy.name,
+									f, found.size(), reference[f].size());
+						consistent = false;
+					}
+				}
+
+				// Then back and forth through the frames, so every step is 1 s as in service
+				samples.clear();
+				double elapsed = 0;
+				for (uint32_t step = FRAMES; elapsed < MIN_RUN_MS || samples.size() < FRAMES; ++step) {
+					uint32_t period = 2 * (FRAMES - 1);
+					uint32_t f = step % period < FRAMES ? step % period : period - step % period;
+					found.clear();
+					auto start = std::chrono::steady_clock::now();
+					strategy.detect(frames[f].view(), found);
+					double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+					samples.push_back(ms);
+					elapsed += ms;
+				}
+				std::sort(samples.begin(), samples.end());
+				double mean = elapsed / samples.size();
+				std::printf("  %-16s %12.3f %12.3f %12.3f %12.1f %10.3f\n", strategy.name, mean, percentile(samples, 0.5),
+							percentile(samples, 0.99), 1000 / mean, pairCount > 0 ? mean * 1e6 / pairCount : 0.0);
+			}
+		}
+	}
+	std::printf("\n%s\n", consistent ? "all strategies found the same conflicts" : "STRATEGIES DISAGREE");
+	return consistent ? EXIT_SUCCESS : EXIT_FAILURE;
+}
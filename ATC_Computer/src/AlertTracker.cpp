@@ -0,0 +1,83 @@
+#include "AlertTracker.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Orders an alert against a conflict by their plane pair
+int comparePair(const msg_alert& alert, const msg_collision& conflict) {
+	if (alert.plane1 != conflict.plane1) {
+		return alert.plane1 < conflict.plane1 ? -1 : 1;
+	}
+	if (alert.plane2 != conflict.plane2) {
+		return alert.plane2 < conflict.plane2 ? -1 : 1;
+	}
+	return 0;
+}
+
+}
+
+void AlertTracker::update(uint64_t timestamp, const std::vector<msg_collision>& conflicts, std::vector<msg_alert>& transitions) {
+	transitions.clear();
+	next.clear();
+
+	size_t a = 0;
+	size_t c = 0;
+	while (a < alerts.size() || c < conflicts.size()) {
+		int order = a == alerts.size() ? 1 : c == conflicts.size() ? -1 : comparePair(alerts[a], conflicts[c]);
+
+		if (order < 0) {
+			// Not found this time
+			msg_alert resolved = alerts[a++];
+			resolved.state = ALERT_RESOLVED;
+			resolved.updated = timestamp;
+			transitions.push_back(resolved);
+			continue;
+		}
+
+		const msg_collision& conflict = conflicts[c++];
+		msg_alert alert;
+		if (order > 0) {
+			alert.plane1 = conflict.plane1;
+			alert.plane2 = conflict.plane2;
+			alert.state = conflict.conflictTime <= ALERT_ESCALATION_S ? ALERT_ESCALATED : ALERT_NEW;
+			alert.severity = conflict.severity;
+			alert.firstSeen = timestamp;
+			alert.conflictTime = conflict.conflictTime;
+			alert.closestApproach = conflict.closestApproach;
+			alert.updated = timestamp;
+			transitions.push_back(alert);
+			next.push_back(alert);
+			continue;
+		}
+
+		alert = alerts[a++];
+		int state = alert.state;
+		if (conflict.conflictTime <= ALERT_ESCALATION_S) {
+			state = ALERT_ESCALATED;
+		} else if (state == ALERT_NEW) {
+			state = ALERT_ONGOING;
+		}
+
+		// What the Display shows now, counted down from the last update
+		float elapsed = (timestamp - alert.updated) / 1000.0f;
+		float shownConflict = std::max(alert.conflictTime - elapsed, 0.0f);
+		bool retimed = std::fabs(conflict.conflictTime - shownConflict) > ALERT_RETIME_TOLERANCE_S;
+
+		if (state != alert.state || conflict.severity != alert.severity || retimed) {
+			alert.state = state;
+			alert.severity = conflict.severity;
+			alert.conflictTime = conflict.conflictTime;
+			alert.closestApproach = conflict.closestApproach;
+			alert.updated = timestamp;
+			transitions.push_back(alert);
+		}
+		next.push_back(alert);
+	}
+
+	alerts.swap(next);
+}
+
+const std::vector<msg_alert>& AlertTracker::getAlerts() const {
+	return alerts;
+}
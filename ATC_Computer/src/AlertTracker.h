@@ -0,0 +1,50 @@
+/*
+ * Alert state of every conflicting pair, carried from one evaluation to the
+ * next so that only the changes have to reach the Display.
+ *
+ * A pair the collision check reports for the first time raises a NEW alert
+ * (or an ESCALATED one if separation is already lost within
+ * ALERT_ESCALATION_S). The next evaluation that still finds it makes it
+ * ONGOING, and it is ESCALATED once the loss of separation comes within
+ * ALERT_ESCALATION_S; it stays escalated until resolved. A pair missing from
+ * an evaluation is RESOLVED and dropped.
+ *
+ * Each alert keeps its predicted times together with the frame time they were
+ * predicted from, so the Display can count them down by itself. While the
+ * prediction holds, an alert produces no transition at all; it is only sent
+ * again when its state or severity changes, or the new prediction is more
+ * than ALERT_RETIME_TOLERANCE_S off the counted-down one.
+ *
+ * Both the conflicts and the alerts are sorted by (plane1, plane2), so an
+ * update is one merge of the two lists.
+ */
+
+#ifndef ALERTTRACKER_H_
+#define ALERTTRACKER_H_
+
+#include <cstdint>
+#include <vector>
+#include "Msg_structs.h"
+
+// Time to loss of separation under which an alert escalates
+const float ALERT_ESCALATION_S = 60;
+
+// Drift of the predicted conflict time that is sent as an update
+const float ALERT_RETIME_TOLERANCE_S = 5;
+
+class AlertTracker {
+public:
+	// Apply one evaluation's conflicts, found in the frame at `timestamp` (ms) and
+	// sorted by (plane1, plane2); fills `transitions` with the alerts that changed,
+	// in the same order
+	void update(uint64_t timestamp, const std::vector<msg_collision>& conflicts, std::vector<msg_alert>& transitions);
+
+	// Current alerts, sorted by (plane1, plane2)
+	const std::vector<msg_alert>& getAlerts() const;
+
+private:
+	std::vector<msg_alert> alerts;
+	std::vector<msg_alert> next;	// Built by update, then swapped with alerts
+};
+
+#endif /* ALERTTRACKER_H_ */
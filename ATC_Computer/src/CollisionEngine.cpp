@@ -0,0 +1,126 @@
+#include "CollisionEngine.h"
+#include <algorithm>
+
+// Grid units per worker, so that a slow unit does not hold up the round
+const uint32_t UNITS_PER_WORKER = 4;
+
+CollisionEngine::CollisionEngine(const Separation& sep, unsigned workerThreads, BroadPhase phase)
+	: separation(sep), broadPhase(phase), grid(sep.x, sep.y, sep.z), sweep(sep.x, sep.y, sep.z), workerCount(std::max(workerThreads, 1u)), horizon(0), nextUnit(0), pool(workerCount) {
+	scratch.resize(workerCount);
+	candidateBuffers.resize(workerCount);
+	conflictBuffers.resize(workerCount);
+}
+
+void CollisionEngine::evaluate(const PlaneView& framePlanes, double lookahead, std::vector<msg_collision>& conflicts) {
+	planes = framePlanes;
+	horizons.assign(1, lookahead);
+	run(conflicts);
+}
+
+void CollisionEngine::evaluate(const PlaneView& framePlanes, const std::vector<double>& lookaheads, std::vector<msg_collision>& conflicts) {
+	planes = framePlanes;
+	horizons = lookaheads;
+	std::sort(horizons.begin(), horizons.end());
+	run(conflicts);
+}
+
+void CollisionEngine::run(std::vector<msg_collision>& conflicts) {
+	conflicts.clear();
+	if (horizons.empty()) {
+		return;
+	}
+	horizon = horizons.back();
+
+	if (broadPhase == BROAD_PHASE_SWEEP) {
+		sweep.update(planes, horizon);
+		sweep.getCandidates(candidates);
+	} else {
+		// Broad phase: every worker collects whole grid units into its own buffer
+		grid.prepare(planes, horizon, workerCount > 1 ? workerCount * UNITS_PER_WORKER : 1);
+		nextUnit.store(0, std::memory_order_relaxed);
+		pool.run([this](unsigned index) { collectCandidates(index); });
+
+		// A pair close during several slices may come from several units
+		candidates.clear();
+		for (const auto& buffer : candidateBuffers) {
+			candidates.insert(candidates.end(), buffer.begin(), buffer.end());
+		}
+		std::sort(candidates.begin(), candidates.end());
+		candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+		grid.setCandidateCount(candidates.size());
+	}
+
+	// Narrow phase: equal shares of the candidates, never splitting one plane's partners
+	shareStart.assign(workerCount + 1, candidates.size());
+	shareStart[0] = 0;
+	for (unsigned i = 1; i < workerCount; ++i) {
+		size_t start = std::max(shareStart[i - 1], candidates.size() * i / workerCount);
+		while (start > 0 && start < candidates.size() && candidates[start].first == candidates[start - 1].first) {
+			++start;
+		}
+		shareStart[i] = start;
+	}
+	pool.run([this](unsigned index) { narrowPhase(index); });
+
+	for (const auto& buffer : conflictBuffers) {
+		conflicts.insert(conflicts.end(), buffer.begin(), buffer.end());
+	}
+	// Already in index order; ids only follow it when the planes are sorted by id
+	std::sort(conflicts.begin(), conflicts.end(), [](const msg_collision& a, const msg_collision& b) {
+		return a.plane1 != b.plane1 ? a.plane1 < b.plane1 : a.plane2 < b.plane2;
+	});
+}
+
+void CollisionEngine::collectCandidates(unsigned index) {
+	std::vector<std::pair<uint32_t, uint32_t>>& buffer = candidateBuffers[index];
+	buffer.clear();
+	uint32_t units = grid.getUnitCount();
+	for (uint32_t unit = nextUnit.fetch_add(1, std::memory_order_relaxed); unit < units;
+		 unit = nextUnit.fetch_add(1, std::memory_order_relaxed)) {
+		grid.collectUnit(planes, unit, scratch[index], buffer);
+	}
+}
+
+// Tests each plane of the share against its candidates a block at a time (candidates
+// are sorted, so a plane's partners are adjacent), then gets the conflict times and
+// severity of the hits
+void CollisionEngine::narrowPhase(unsigned index) {
+	std::vector<msg_collision>& buffer = conflictBuffers[index];
+	buffer.clear();
+	size_t next = shareStart[index];
+	size_t end = shareStart[index + 1];
+	while (next < end) {
+		uint32_t plane = candidates[next].first;
+		uint32_t others[CONFLICT_BLOCK];
+		uint32_t count = 0;
+		while (next < end && candidates[next].first == plane && count < CONFLICT_BLOCK) {
+			others[count++] = candidates[next++].second;
+		}
+
+		uint32_t mask = conflictMask(planes, plane, others, count, separation, horizon);
+		for (; mask; mask &= mask - 1) {
+			uint32_t other = others[__builtin_ctz(mask)];
+			ConflictResult conflict;
+			sweptConflict(planes, plane, other, separation, horizon, conflict);
+			int first = planes.id(plane);
+			int second = planes.id(other);
+			// Every horizon from the first one the conflict starts within
+			int severity = horizons.end() - std::lower_bound(horizons.begin(), horizons.end(), conflict.firstConflict);
+			msg_collision collision = {std::min(first, second), std::max(first, second),
+									   static_cast<float>(conflict.firstConflict), static_cast<float>(conflict.closestApproach), severity};
+			buffer.push_back(collision);
+		}
+	}
+}
+
+unsigned CollisionEngine::getWorkerCount() const {
+	return workerCount;
+}
+
+BroadPhase CollisionEngine::getBroadPhase() const {
+	return broadPhase;
+}
+
+size_t CollisionEngine::getCandidateCount() const {
+	return candidates.size();
+}
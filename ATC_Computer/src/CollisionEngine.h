@@ -0,0 +1,90 @@
+/*
+ * The collision check of one frame: SpatialGrid broad phase, then the conflict
+ * kernel on the candidates, shared out over a fixed pool of worker threads.
+ *
+ * An evaluation runs in two rounds. In the first the workers take grid units
+ * (time slices, or strips of them) off a shared counter and collect candidate
+ * pairs into their own buffers, which are then merged, sorted and
+ * deduplicated. In the second the sorted candidates are cut into one
+ * contiguous share per worker, on plane boundaries, and each worker runs the
+ * narrow phase over its share into its own result buffer. The results are
+ * merged in pair order, so the output does not depend on scheduling and the
+ * same frame always raises the same alerts.
+ *
+ * With a single worker both rounds run on the calling thread.
+ *
+ * The broad phase can instead be the incremental sweep and prune, which keeps
+ * its sorted lists from one evaluation to the next. It is updated on the
+ * calling thread and only the narrow phase is shared out.
+ *
+ * Conflicts can be graded against several lookahead horizons at once. Both
+ * phases run once, for the longest horizon, and the entry time the narrow
+ * phase finds for a pair grades it against every shorter horizon too: its
+ * severity is the number of horizons it falls within.
+ */
+
+#ifndef COLLISIONENGINE_H_
+#define COLLISIONENGINE_H_
+
+#include <atomic>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "Msg_structs.h"
+#include "SharedAirspace.h"
+#include "SpatialGrid.h"
+#include "SweepAndPrune.h"
+#include "ConflictDetection.h"
+#include "ConflictKernel.h"
+#include "WorkerPool.h"
+
+enum BroadPhase {
+	BROAD_PHASE_GRID,	// Space-time grid, rebuilt every evaluation
+	BROAD_PHASE_SWEEP	// Sweep and prune, updated incrementally
+};
+
+class CollisionEngine {
+public:
+	CollisionEngine(const Separation& separation, unsigned workers = 1, BroadPhase broadPhase = BROAD_PHASE_GRID);
+
+	// Pairs of `planes` that lose separation within [0, horizon] seconds, with
+	// plane1 < plane2 and sorted by (plane1, plane2); all have severity 1
+	void evaluate(const PlaneView& planes, double horizon, std::vector<msg_collision>& conflicts);
+	// The same for the longest of `horizons`, each conflict graded by how many of
+	// them it falls within
+	void evaluate(const PlaneView& planes, const std::vector<double>& horizons, std::vector<msg_collision>& conflicts);
+
+	unsigned getWorkerCount() const;
+	BroadPhase getBroadPhase() const;
+	// Candidate pairs the broad phase found in the last evaluation
+	size_t getCandidateCount() const;
+
+private:
+	void run(std::vector<msg_collision>& conflicts);
+	void collectCandidates(unsigned index);
+	void narrowPhase(unsigned index);
+
+	Separation separation;
+	BroadPhase broadPhase;
+	SpatialGrid grid;
+	SweepAndPrune sweep;
+	unsigned workerCount;
+
+	// The evaluation in progress
+	PlaneView planes;
+	std::vector<double> horizons;	// Ascending
+	double horizon;					// The longest of them
+	std::atomic<uint32_t> nextUnit;		// Next grid unit to hand out
+	std::vector<std::pair<uint32_t, uint32_t>> candidates;	// Merged broad phase output
+	std::vector<size_t> shareStart;		// First candidate of each worker's share, plus an end marker
+
+	// One per worker
+	std::vector<SpatialGrid::Scratch> scratch;
+	std::vector<std::vector<std::pair<uint32_t, uint32_t>>> candidateBuffers;
+	std::vector<std::vector<msg_collision>> conflictBuffers;
+
+	// Last, so that its threads are joined before the buffers they use go away
+	WorkerPool pool;
+};
+
+#endif /* COLLISIONENGINE_H_ */
@@ -7,6 +7,7 @@
 #include <cstring> // For memcpy
 
 #define COMMS_CHANNEL_NAME "AH_40247851_40228573_Comms"
+#define SIMULATION_CHANNEL_NAME "AH_40247851_40228573_Simulation"  // Queues commands for every aircraft of the simulation
 
 CommunicationsSystem::CommunicationsSystem() {
     Communications_System = std::thread(&CommunicationsSystem::HandleCommunications, this);
@@ -95,24 +96,31 @@ void CommunicationsSystem::HandleCommunications() {
 }
 
 void CommunicationsSystem::messageAircraft(const Message_inter_process& msg) {
-    // Open channel to the specific aircraft
+    // The simulation queues the command in the aircraft's inbox straight away, where the
+    // aircraft itself would only receive it between two steps. Simulations without that
+    // channel still take commands on each aircraft's own channel.
     std::string plane_channel_name = "AH_40247851_40228573_" + std::to_string(msg.planeID);
-    int plane_channel = name_open(plane_channel_name.c_str(), 0);
+    std::string channel_name = SIMULATION_CHANNEL_NAME;
+    int plane_channel = name_open(channel_name.c_str(), 0);
+    if (plane_channel == -1) {
+        channel_name = plane_channel_name;
+        plane_channel = name_open(channel_name.c_str(), 0);
+    }
 
     if (plane_channel == -1) {
+        int error = errno;  // Taken before the stream calls below can change it
         std::cerr << "Failed to open channel to Plane " << msg.planeID << " (" << plane_channel_name << ")\n";
-        std::cerr << "  Error: " << strerror(errno) << "\n";
+        std::cerr << "  Error: " << strerror(error) << "\n";
         std::cerr << "  Plane may have left airspace or channel doesn't exist yet\n";
         return;
     }
 
-    std::cout << "Successfully opened channel to Plane " << msg.planeID << "\n";
-
-    // Send the Message_inter_process directly to the aircraft
+    // Send the Message_inter_process to the simulation, or directly to the aircraft
     int reply;
     if (MsgSend(plane_channel, &msg, sizeof(msg), &reply, sizeof(reply)) == -1) {
-        std::cerr << "Failed to send message to Plane " << msg.planeID << "\n";
-        std::cerr << "  Error: " << strerror(errno) << "\n";
+        int error = errno;
+        std::cerr << "Failed to send command to Plane " << msg.planeID << " on " << channel_name << "\n";
+        std::cerr << "  Error: " << strerror(error) << "\n";
     } else {
         std::cout << "Successfully sent command to Plane " << msg.planeID << "\n";
     }
@@ -4,14 +4,28 @@
 #include <iomanip>      // For std::put_time
 #include <cmath>
 #include <sys/dispatch.h>
+#include <sys/neutrino.h>
 #include "Msg_structs.h"
 #include <cstring> // For memcpy
+#include <memory>
+#include <chrono>
+#include <algorithm>
 
 // COEN320 Task 3.1, set the display channel name
 #define display_channel_name "40247851_40228573_Display"
+#define computer_channel_name "AH_40247851_40228573_Computer"
 
+// Longest wait for a frame before checking whether to stop
+const uint32_t FRAME_WAIT_TIMEOUT_MS = 1000;
 
-ComputerSystem::ComputerSystem() : shm_fd(-1), shared_mem(nullptr), running(false) {}
+
+// Evaluations between two throughput reports
+const uint32_t STATS_REPORT_INTERVAL = 60;
+
+ComputerSystem::ComputerSystem(uint32_t periodMs, unsigned collisionWorkers, BroadPhase broadPhase, bool clock)
+	: conflictHorizons(DEFAULT_CONFLICT_HORIZONS), horizonsChanged(false), evaluationPeriodMs(periodMs), followClock(clock),
+	  engine(Separation{CONSTRAINT_X, CONSTRAINT_Y, CONSTRAINT_Z}, collisionWorkers, broadPhase),
+	  advisor(Separation{CONSTRAINT_X, CONSTRAINT_Y, CONSTRAINT_Z}, AIRSPACE_MIN_Z, AIRSPACE_MAX_Z, collisionWorkers), running(false) {}
 
 ComputerSystem::~ComputerSystem() {
     joinThread();
@@ -21,26 +35,17 @@ ComputerSystem::~ComputerSystem() {
 bool ComputerSystem::initializeSharedMemory() {
 	// Open the shared memory object
 	while (true) {
-		 // COEN320 Task 3.2
-		// Attempt to open the shared memory object (You need to use the same name as Task 2 in Radar)
-		shm_fd = shm_open("/tmp/AH_40247851_40228573_Radar_shm", O_RDONLY, 0666);
-
-		if (shm_fd == -1) {
+		// Map the header first; the reader sizes the rest of the mapping from the
+		// capacity and layout version the Radar recorded there
+		if (!airspace.open()) {
 			std::cerr << "Failed to open shared memory, retrying..." << std::endl;
 			sleep(1);  // Wait before retrying to give radar time to create if needed
 			continue;
 		}
 
-		// COEN320 Task 3.3
-		// Map the shared memory object into the process's address space
-		shared_mem = (SharedMemory*)mmap(NULL, sizeof(SharedMemory), PROT_READ, MAP_SHARED, shm_fd, 0);
-
-		if (shared_mem == MAP_FAILED) {
-			std::cerr << "Failed to map shared memory, retrying..." << std::endl;
-			close(shm_fd);
-			shm_fd = -1;
-			sleep(1);
-			continue;
+		// The conflict table is ours; the Display maps it once we announce a report
+		if (!conflictTable.open()) {
+			return false;
 		}
 
 		//std::cout << "Shared memory initialized successfully" << std::endl;
@@ -50,12 +55,8 @@ bool ComputerSystem::initializeSharedMemory() {
 }
 
 void ComputerSystem::cleanupSharedMemory() {
-    if (shared_mem && shared_mem != MAP_FAILED) {
-        munmap(shared_mem, sizeof(SharedMemory));
-    }
-    if (shm_fd != -1) {
-        close(shm_fd);
-    }
+    airspace.close();
+    conflictTable.close();
 }
 
 bool ComputerSystem::startMonitoring() {
@@ -63,6 +64,7 @@ bool ComputerSystem::startMonitoring() {
         running = true;
         //std::cout << "Starting monitoring thread." << std::endl;
         monitorThread = std::thread(&ComputerSystem::monitorAirspace, this);
+        monitorOperatorInput = std::thread(&ComputerSystem::processMessage, this);
         return true;
     } else {
         std::cerr << "Failed to initialize shared memory. Monitoring not started.\n";
@@ -74,67 +76,113 @@ void ComputerSystem::joinThread() {
     if (monitorThread.joinable()) {
         monitorThread.join();
     }
+    if (monitorOperatorInput.joinable()) {
+        monitorOperatorInput.join();
+    }
 }
 
 void ComputerSystem::monitorAirspace() {
-	//std::cout << "Initial is_empty value: " << shared_mem->is_empty.load() << std::endl;
-	ATCTimer timer(1,0);
-	// Vector to store plane data
-	std::vector<msg_plane_info> plane_data_vector;
+	//std::cout << "Initial is_empty value: " << airspace.isEmpty() << std::endl;
+	// Without a period of our own, wake on every frame the Radar publishes
+	// On the virtual clock the same happens in our turn of each tick instead
+	std::unique_ptr<ClockParticipant> participant;
+	std::unique_ptr<ATCTimer> timer;
+	if (followClock) {
+		while (!virtualClock.open()) {
+			std::cerr << "Failed to open virtual clock, retrying..." << std::endl;
+			sleep(1);
+		}
+		participant.reset(new ClockParticipant(virtualClock, CLOCK_STAGE_COMPUTER));
+	} else if (evaluationPeriodMs) {
+		timer.reset(new ATCTimer(evaluationPeriodMs / 1000, evaluationPeriodMs % 1000));
+	}
+	uint64_t seenFrame = 0;
+	uint64_t nextEvaluationMs = 0;
+	bool inTurn = false;
+	auto due = [&]() {
+		if (evaluationPeriodMs) {
+			return participant->now() >= nextEvaluationMs;
+		}
+		uint64_t latest = airspace.waitForFrame(seenFrame, 0);
+		bool published = (latest != seenFrame);
+		seenFrame = latest;
+		return published;
+	};
+	auto waitNext = [&]() {
+		if (participant) {
+			if (inTurn) {
+				participant->complete();
+			}
+			inTurn = participant->waitUntil(due);
+			if (!inTurn) {
+				running = false;  // The simulation stopped the clock
+			}
+			nextEvaluationMs = participant->now() + evaluationPeriodMs;
+		} else if (timer) {
+			timer->waitTimer();
+		} else {
+			seenFrame = airspace.waitForFrame(seenFrame, FRAME_WAIT_TIMEOUT_MS);
+		}
+	};
+	// Plane data, kept in columns for the collision loop
+	PlaneColumns plane_data;
 	uint64_t timestamp;
     // Keep monitoring indefinitely until `stopMonitoring` is called
-	while (shared_mem->is_empty.load()) {
+	while (running && airspace.isEmpty()) {
 		std::cout << "Waiting for planes in airspace...\n";
-		timer.waitTimer();
+		waitNext();
 	}
 
+	uint64_t evaluatedFrame = 0;
 	while (running) {
-		if (shared_mem->is_empty.load()) {
+		// No new frame since the last evaluation (the wait timed out, or the period came
+		// round before the next sweep): the published report still stands
+		if (airspace.waitForFrame(evaluatedFrame, 0) == evaluatedFrame && !horizonsChanged.load()) {
+			waitNext();
+			continue;
+		}
+
+		// Only the planes listed in the frame deltas are re-read; the rest move along their velocity
+		tracker.update(airspace);
+		evaluatedFrame = tracker.getFrameNumber();
+		if (tracker.getPlanes().empty()) {
 			std::cout << "No planes in airspace. Stopping monitoring.\n";
 			running = false;
 	        break;
-        } else {
-        	plane_data_vector.clear();
-
-            timestamp = shared_mem->timestamp;
-            //std::cout << "Last Update Timestamp: " << timestamp << "\n";
-            //std::cout << "Number of planes in shared memory: " << shared_mem->count << "\n";
-
-            for (int i = 0; i < shared_mem->count; ++i) {
-            	const msg_plane_info& plane = shared_mem->plane_data[i];
-            	// Store the plane info in the vector
-            	plane_data_vector.push_back(plane);
-            }
         }
-
-		if (plane_data_vector.size()>1)
-            checkCollision(timestamp, plane_data_vector);
-		else
-           // std::cout << "No collision possible with single plane\n";
-        // Sleep for a short interval before the next poll
-       timer.waitTimer();
+		timestamp = tracker.getTimestamp();
+		tracker.extrapolate(timestamp, plane_data);
+        //std::cout << "Last Update Timestamp: " << timestamp << "\n";
+        //std::cout << "Number of planes in shared memory: " << plane_data.size() << "\n";
+
+		// A single plane has no conflicts, but still clears the last report
+		checkCollision(timestamp, plane_data.view());
+        // Sleep until the next frame (or period) before the next poll
+       waitNext();
     }
 	std::cout << "Exiting monitoring loop." << std::endl;
 }
 
-void ComputerSystem::checkCollision(uint64_t currentTime, std::vector<msg_plane_info> planes) {
+void ComputerSystem::checkCollision(uint64_t currentTime, const PlaneView& planes) {
     // COEN320 Task 3.4
     // detect collisions between planes in the airspace within the time constraint
 
-    std::vector<std::pair<int, int>> collisionPairs;
+    // Horizons the operator changed since the last frame
+    if (horizonsChanged.exchange(false)) {
+    	std::lock_guard<std::mutex> lock(horizonMutex);
+    	conflictHorizons = requestedHorizons;
+    }
+
+    std::vector<msg_collision> collisionPairs;
+    if (planes.size() > 1) {
+    	auto start = std::chrono::steady_clock::now();
 
-    // Check ALL pairs of planes
-    for (size_t i = 0; i < planes.size(); i++) {
-    	for (size_t j = i + 1; j < planes.size(); j++) {
-    		// Check if planes will collide
-    		if (checkAxes(planes[i], planes[j])) {
-    			collisionPairs.emplace_back(planes[i].id, planes[j].id);
+    	// Grid broad phase, then the exact test on the candidates, over the engine's workers.
+    	// One pass for the longest horizon grades each conflict against all of them.
+    	engine.evaluate(planes, conflictHorizons, collisionPairs);
 
-    			// Debug output
-    			//std::cout << " ComputerSystem detected collision: Plane "
-    			     //     << planes[i].id << " ⟷ Plane " << planes[j].id << "\n";
-    		}
-    	}
+    	recordEvaluation(planes.size(), engine.getCandidateCount(),
+    					 std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
     }
 
     // Debug output - show total pairs detected
@@ -144,67 +192,71 @@ void ComputerSystem::checkCollision(uint64_t currentTime, std::vector<msg_plane_
     }
 
     // COEN320 Task 3.5
-    // In the case of collision send message to Display system
-    if (!collisionPairs.empty()) {
+    // Carry the alerts over, publish the full set to the conflict table, and
+    // send the Display only what changed. An alert that holds its prediction
+    // costs no message at all.
+    alerts.update(currentTime, collisionPairs, alertTransitions);
+
+    // Maneuvers that would clear the conflicts, within a fixed time per frame
+    advisor.advise(planes, collisionPairs, conflictHorizons.back(), advisories);
+    if (advisor.getAdvisedClusterCount() < advisor.getClusterCount()) {
+    	std::cout << "ComputerSystem: advisories for " << advisor.getAdvisedClusterCount() << " of "
+    			  << advisor.getClusterCount() << " conflict clusters within the time budget\n";
+    }
 
-    	Message_inter_process msg_to_send;
+    uint64_t reportNumber = conflictTable.publish(tracker.getFrameNumber(), currentTime, alerts.getAlerts(), advisories);
+    if (reportNumber && !alertTransitions.empty()) {
 
-    	size_t numPairs = collisionPairs.size();
-    	size_t dataSize = numPairs * sizeof(std::pair<int, int>);
+    	Message_inter_process msg_to_send;
+    	AlertDelta delta = {reportNumber, lastDeltaReport, static_cast<uint32_t>(alertTransitions.size())};
+    	size_t count = alertTransitions.size();
+    	if (count > ALERT_DELTA_CAPACITY) {
+    		// The Display reads the whole set from the table instead
+    		delta.count = ALERT_DELTA_OVERFLOW;
+    		count = 0;
+    	}
 
     	msg_to_send.header = true;  // Inter-process message
     	msg_to_send.planeID = -1;
     	msg_to_send.type = MessageType::COLLISION_DETECTED;
-    	msg_to_send.dataSize = dataSize;
-
-    	// Verify we're copying all pairs
-    	//std::cout << "ComputerSystem: Sending " << numPairs << " collision pairs to Display\n";
-    	std::memcpy(msg_to_send.data.data(), collisionPairs.data(), dataSize);
+    	msg_to_send.dataSize = sizeof(delta) + count * sizeof(msg_alert);
+    	std::memcpy(msg_to_send.data.data(), &delta, sizeof(delta));
+    	std::memcpy(msg_to_send.data.data() + sizeof(delta), alertTransitions.data(), count * sizeof(msg_alert));
 
     	sendCollisionToDisplay(msg_to_send);
+    	lastDeltaReport = reportNumber;
     }
-    
 }
 
-bool ComputerSystem::checkAxes(msg_plane_info plane1, msg_plane_info plane2) {
-    // COEN320 Task 3.4
-    // A collision is defined as two planes entering the defined airspace constraints within the time constraint
-
-    // Calculate the distance between the two planes in each axis (current position)
-    double deltaX = std::abs(plane1.PositionX - plane2.PositionX);
-    double deltaY = std::abs(plane1.PositionY - plane2.PositionY);
-    double deltaZ = std::abs(plane1.PositionZ - plane2.PositionZ);
-
-    // Check if the planes are currently within the constraint distances
-    if (deltaX < CONSTRAINT_X && deltaY < CONSTRAINT_Y && deltaZ < CONSTRAINT_Z) {
-        // Planes are too close right now - collision detected
-        return true;
-    }
-
-    // Predict positions after time constraint
-    double futureX1 = plane1.PositionX + plane1.VelocityX * timeConstraintCollisionFreq;
-    double futureY1 = plane1.PositionY + plane1.VelocityY * timeConstraintCollisionFreq;
-    double futureZ1 = plane1.PositionZ + plane1.VelocityZ * timeConstraintCollisionFreq;
-
-    double futureX2 = plane2.PositionX + plane2.VelocityX * timeConstraintCollisionFreq;
-    double futureY2 = plane2.PositionY + plane2.VelocityY * timeConstraintCollisionFreq;
-    double futureZ2 = plane2.PositionZ + plane2.VelocityZ * timeConstraintCollisionFreq;
-
-    // Check if future positions will be within constraints
-    double futureDeltaX = std::abs(futureX1 - futureX2);
-    double futureDeltaY = std::abs(futureY1 - futureY2);
-    double futureDeltaZ = std::abs(futureZ1 - futureZ2);
-
-    if (futureDeltaX < CONSTRAINT_X && futureDeltaY < CONSTRAINT_Y && futureDeltaZ < CONSTRAINT_Z) {
-        // Planes will be too close in the future - collision predicted
-        return true;
-    }
+// Accumulates broad + narrow phase timings and prints the averages every
+// STATS_REPORT_INTERVAL evaluations. "Covered" counts every pair the check
+// answers for, n(n-1)/2, so it rises linearly with n while the grid keeps
+// the time per evaluation near-linear.
+void ComputerSystem::recordEvaluation(uint32_t planeCount, size_t candidates, double elapsedMs) {
+	statsEvaluations++;
+	statsPlanes += planeCount;
+	statsCandidates += candidates;
+	statsPairsCovered += planeCount * (planeCount - 1.0) / 2;
+	statsElapsedMs += elapsedMs;
+	if (statsEvaluations < STATS_REPORT_INTERVAL) {
+		return;
+	}
 
-    // No collision detected
-    return false;
+	double seconds = std::max(statsElapsedMs / 1000.0, 1e-9);
+	std::cout << "ComputerSystem: " << statsPlanes / statsEvaluations << " aircraft, "
+			  << statsCandidates / statsEvaluations << " candidate pairs, "
+			  << statsElapsedMs / statsEvaluations << " ms per check, "
+			  << statsCandidates / seconds << " candidate pairs/s, "
+			  << statsPairsCovered / seconds << " pairs covered/s (" << engine.getWorkerCount() << " workers, "
+			  << (engine.getBroadPhase() == BROAD_PHASE_SWEEP ? "sweep and prune" : "grid") << ", "
+			  << conflictKernelIsa() << " kernel)\n";
+	statsEvaluations = 0;
+	statsPlanes = 0;
+	statsCandidates = 0;
+	statsPairsCovered = 0;
+	statsElapsedMs = 0;
 }
 
-
 void ComputerSystem::sendCollisionToDisplay(const Message_inter_process& msg){
 	int display_channel = name_open(display_channel_name, 0);
 	if (display_channel == -1) {
@@ -221,3 +273,68 @@ void ComputerSystem::sendCollisionToDisplay(const Message_inter_process& msg){
 	}
 	name_close(display_channel);
 }
+
+// Listens for the Operator Console's requests until monitoring stops
+void ComputerSystem::processMessage() {
+	name_attach_t* computer_channel = name_attach(NULL, computer_channel_name, 0);
+	if (computer_channel == NULL) {
+		std::cerr << "Computer system: Failed to create channel: " << computer_channel_name << "\n";
+		return;
+	}
+
+	while (running) {
+		Message_inter_process msg;
+		memset(&msg, 0, sizeof(msg));
+
+		// Wake up now and then to notice that monitoring stopped
+		struct sigevent event;
+		SIGEV_UNBLOCK_INIT(&event);
+		uint64_t timeout = 500000000ULL;
+		TimerTimeout(CLOCK_MONOTONIC, _NTO_TIMEOUT_RECEIVE, &event, &timeout, NULL);
+
+		int rcvid = MsgReceive(computer_channel->chid, &msg, sizeof(msg), NULL);
+		if (rcvid == -1) continue;
+		if (rcvid == 0) continue;
+
+		int reply = -1;
+		if (msg.header && msg.type == MessageType::CHANGE_TIME_CONSTRAINT_COLLISIONS) {
+			reply = handleTimeConstraintChange(msg) ? 0 : -1;
+		}
+		MsgReply(rcvid, 0, &reply, sizeof(reply));
+	}
+
+	name_detach(computer_channel, 0);
+}
+
+// Stages a new set of lookahead horizons for the next frame
+bool ComputerSystem::handleTimeConstraintChange(const Message_inter_process& msg) {
+	msg_change_horizons change;
+	if (msg.dataSize != sizeof(change)) {
+		return false;
+	}
+	memcpy(&change, msg.data.data(), sizeof(change));
+	if (change.count < 1 || change.count > MAX_CONFLICT_HORIZONS) {
+		return false;
+	}
+
+	std::vector<double> horizons;
+	for (int i = 0; i < change.count; i++) {
+		if (!(change.horizons[i] > 0)) {
+			return false;
+		}
+		horizons.push_back(change.horizons[i]);
+	}
+	std::sort(horizons.begin(), horizons.end());
+	horizons.erase(std::unique(horizons.begin(), horizons.end()), horizons.end());
+
+	std::cout << "ComputerSystem: conflict horizons set to";
+	for (double horizon : horizons) {
+		std::cout << " " << horizon;
+	}
+	std::cout << " s\n";
+
+	std::lock_guard<std::mutex> lock(horizonMutex);
+	requestedHorizons = horizons;
+	horizonsChanged = true;
+	return true;
+}
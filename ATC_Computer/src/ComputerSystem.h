@@ -10,16 +10,36 @@
 #include <unistd.h>
 #include <chrono>
 #include <vector>
+#include <mutex>
 
 const double CONSTRAINT_X = 3000;
 const double CONSTRAINT_Y = 3000;
 const double CONSTRAINT_Z = 1000;
 
+// Vertical extent of the airspace; an advisory never sends an aircraft out of it
+const double AIRSPACE_MIN_Z = 15000;
+const double AIRSPACE_MAX_Z = 40000;
+
+// Lookahead horizons in seconds until the operator sets others
+const std::vector<double> DEFAULT_CONFLICT_HORIZONS = {30, 60, 120, 180};
+
 #include "Msg_structs.h"
+#include "SharedAirspace.h"
+#include "CollisionEngine.h"
+#include "ConflictTable.h"
+#include "AlertTracker.h"
+#include "ResolutionAdvisor.h"
+#include "VirtualClock.h"
 
 class ComputerSystem {
 public:
-    ComputerSystem();
+    // evaluationPeriodMs is the time between two collision evaluations;
+    // 0 evaluates every frame as soon as the Radar publishes it.
+    // collisionWorkers is the number of threads sharing each evaluation.
+    // followClock runs on the simulation's virtual clock: once per tick, after the Radar,
+    // with evaluationPeriodMs counted in virtual time.
+    ComputerSystem(uint32_t evaluationPeriodMs = 0, unsigned collisionWorkers = 1, BroadPhase broadPhase = BROAD_PHASE_GRID,
+                   bool followClock = false);
     ~ComputerSystem();
 
     bool startMonitoring();
@@ -31,22 +51,44 @@ private:
     void cleanupSharedMemory();
 
     //Collsion detection
-    void checkCollision(uint64_t currentTime, std::vector<msg_plane_info> planes);
-    bool checkAxes(msg_plane_info plane1, msg_plane_info plane2);
+    void checkCollision(uint64_t currentTime, const PlaneView& planes);
+    void recordEvaluation(uint32_t planeCount, size_t candidates, double elapsedMs);
     bool sameSpeed(double peed1, double speed2);
 
     //Handle messages from operator
     void processMessage();
     void sendMessagesToComms(const Message& msg);
-    void handleTimeConstraintChange(const Message& msg);
+    bool handleTimeConstraintChange(const Message_inter_process& msg);
     void sendCollisionToDisplay(const Message_inter_process& msg);
 
-    int timeConstraintCollisionFreq = 180;
+    // Lookahead horizons conflicts are graded against, ascending. The operator's
+    // changes are staged in requestedHorizons and picked up on the next frame.
+    std::vector<double> conflictHorizons;
+    std::vector<double> requestedHorizons;
+    std::mutex horizonMutex;
+    std::atomic<bool> horizonsChanged;
+    uint32_t evaluationPeriodMs;
+    bool followClock;
+    VirtualClock virtualClock;  // Opened by the monitor thread when followClock is set
+
 
 
+    AirspaceReader airspace;
+    AirspaceTracker tracker;
+    CollisionEngine engine;
+    ConflictTableWriter conflictTable;
+    AlertTracker alerts;
+    ResolutionAdvisor advisor;
+    std::vector<msg_advisory> advisories;
+    std::vector<msg_alert> alertTransitions;
+    uint64_t lastDeltaReport = 0;	// Report of the last COLLISION_DETECTED sent
 
-    int shm_fd;
-    SharedMemory* shared_mem;
+    // Collision check throughput, reported every STATS_REPORT_INTERVAL evaluations
+    uint32_t statsEvaluations = 0;
+    double statsPlanes = 0;
+    double statsCandidates = 0;
+    double statsPairsCovered = 0;
+    double statsElapsedMs = 0;
     std::thread monitorThread;
     std::thread monitorOperatorInput;
     std::atomic<bool> running;
@@ -0,0 +1,55 @@
+#include "ConflictDetection.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+bool sweptConflict(const double dp[3], const double dv[3], const Separation& separation, double horizon,
+				   ConflictResult& result) {
+	const double constraint[3] = {separation.x, separation.y, separation.z};
+	const double infinity = std::numeric_limits<double>::infinity();
+
+	// Intersection of the per-axis open intervals |dp + dv * t| < C
+	double enter = -infinity;
+	double exit = infinity;
+	for (int axis = 0; axis < 3; ++axis) {
+		if (dv[axis] == 0) {
+			if (std::abs(dp[axis]) >= constraint[axis]) {
+				return false;
+			}
+			continue;
+		}
+		double t1 = (-constraint[axis] - dp[axis]) / dv[axis];
+		double t2 = (constraint[axis] - dp[axis]) / dv[axis];
+		enter = std::max(enter, std::min(t1, t2));
+		exit = std::min(exit, std::max(t1, t2));
+	}
+
+	// The interval is open, so it has to reach past its clipped ends to count
+	double first = std::max(enter, 0.0);
+	double last = std::min(exit, horizon);
+	if (!(first < last || (enter < first && last < exit && first == last))) {
+		return false;
+	}
+
+	// Minimize sum((dp + dv t)^2 / C^2): t = -sum(dp dv / C^2) / sum(dv^2 / C^2)
+	double numerator = 0;
+	double denominator = 0;
+	for (int axis = 0; axis < 3; ++axis) {
+		double scale = 1.0 / (constraint[axis] * constraint[axis]);
+		numerator += dp[axis] * dv[axis] * scale;
+		denominator += dv[axis] * dv[axis] * scale;
+	}
+	double closest = denominator > 0 ? -numerator / denominator : 0;
+
+	result.firstConflict = first;
+	result.lastConflict = last;
+	result.closestApproach = std::min(std::max(closest, 0.0), horizon);
+	return true;
+}
+
+bool sweptConflict(const PlaneView& planes, uint32_t i, uint32_t j, const Separation& separation, double horizon,
+				   ConflictResult& result) {
+	const double dp[3] = {planes.x(j) - planes.x(i), planes.y(j) - planes.y(i), planes.z(j) - planes.z(i)};
+	const double dv[3] = {planes.vx(j) - planes.vx(i), planes.vy(j) - planes.vy(i), planes.vz(j) - planes.vz(i)};
+	return sweptConflict(dp, dv, separation, horizon, result);
+}
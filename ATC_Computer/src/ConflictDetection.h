@@ -0,0 +1,42 @@
+/*
+ * Closed-form conflict test between two aircraft flying at constant velocity.
+ *
+ * On each axis the separation is d(t) = dp + dv * t, so |d(t)| < C holds on
+ * one open time interval (all of time, or never, when dv is 0). Two aircraft
+ * are in conflict while all three axes are below their constraint, i.e. on
+ * the intersection of the three intervals. Clipping that to [0, horizon]
+ * gives the exact first and last conflict times in constant time, with no
+ * sampling, so an encounter that starts and ends between two samples is
+ * still caught.
+ *
+ * The time of closest approach minimizes the distance measured in units of
+ * the constraint on each axis, sum((d_axis(t) / C_axis)^2), over [0, horizon].
+ */
+
+#ifndef CONFLICTDETECTION_H_
+#define CONFLICTDETECTION_H_
+
+#include <cstdint>
+#include "SharedAirspace.h"
+
+// Minimum separation on each axis
+struct Separation {
+	double x, y, z;
+};
+
+struct ConflictResult {
+	double firstConflict;		// Seconds until separation is lost, 0 if it already is
+	double lastConflict;		// Seconds until it is regained, capped at the horizon
+	double closestApproach;		// Seconds until the two are closest, within [0, horizon]
+};
+
+// True if separation is lost at some time in [0, horizon]. `dp` and `dv` are the
+// relative position and velocity (second minus first) on x, y, z.
+bool sweptConflict(const double dp[3], const double dv[3], const Separation& separation, double horizon,
+				   ConflictResult& result);
+
+// Same for planes i and j of a view
+bool sweptConflict(const PlaneView& planes, uint32_t i, uint32_t j, const Separation& separation, double horizon,
+				   ConflictResult& result);
+
+#endif /* CONFLICTDETECTION_H_ */
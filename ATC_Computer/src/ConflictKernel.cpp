@@ -0,0 +1,219 @@
+#include "ConflictKernel.h"
+#include <limits>
+
+#if !defined(CONFLICT_KERNEL_SCALAR)
+#if defined(__AVX__)
+#include <immintrin.h>
+#define CONFLICT_KERNEL_AVX
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define CONFLICT_KERNEL_SSE2
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define CONFLICT_KERNEL_NEON
+#endif
+#endif
+
+namespace {
+
+const int STATE_COUNT = 6;	// x, y, z, vx, vy, vz
+
+// Mask over a full block. `others[s]` holds CONFLICT_BLOCK values of state s, `self[s]`
+// is plane i's; lanes past the caller's count are masked off by the caller.
+uint32_t blockMask(const double* const others[STATE_COUNT], const double self[STATE_COUNT],
+				   const Separation& separation, double horizon) {
+	const double constraint[3] = {separation.x, separation.y, separation.z};
+	const double infinity = std::numeric_limits<double>::infinity();
+	uint32_t mask = 0;
+
+#if defined(CONFLICT_KERNEL_AVX)
+	const __m256d zero = _mm256_setzero_pd();
+	const __m256d end = _mm256_set1_pd(horizon);
+	const __m256d positive = _mm256_set1_pd(infinity);
+	const __m256d negative = _mm256_set1_pd(-infinity);
+	const __m256d sign = _mm256_set1_pd(-0.0);
+	for (uint32_t lane = 0; lane < CONFLICT_BLOCK; lane += 4) {
+		__m256d enter = negative;
+		__m256d exit = positive;
+		for (int axis = 0; axis < 3; ++axis) {
+			__m256d dp = _mm256_sub_pd(_mm256_loadu_pd(others[axis] + lane), _mm256_set1_pd(self[axis]));
+			__m256d dv = _mm256_sub_pd(_mm256_loadu_pd(others[axis + 3] + lane), _mm256_set1_pd(self[axis + 3]));
+			__m256d c = _mm256_set1_pd(constraint[axis]);
+			__m256d t1 = _mm256_div_pd(_mm256_sub_pd(_mm256_set1_pd(-constraint[axis]), dp), dv);
+			__m256d t2 = _mm256_div_pd(_mm256_sub_pd(c, dp), dv);
+			__m256d low = _mm256_min_pd(t1, t2);
+			__m256d high = _mm256_max_pd(t1, t2);
+
+			// A stationary axis is either always inside or never
+			__m256d stationary = _mm256_cmp_pd(dv, zero, _CMP_EQ_OQ);
+			__m256d inside = _mm256_cmp_pd(_mm256_andnot_pd(sign, dp), c, _CMP_LT_OQ);
+			low = _mm256_blendv_pd(low, _mm256_blendv_pd(positive, negative, inside), stationary);
+			high = _mm256_blendv_pd(high, _mm256_blendv_pd(negative, positive, inside), stationary);
+
+			enter = _mm256_max_pd(enter, low);
+			exit = _mm256_min_pd(exit, high);
+		}
+		__m256d first = _mm256_max_pd(enter, zero);
+		__m256d last = _mm256_min_pd(exit, end);
+		__m256d touching = _mm256_and_pd(_mm256_and_pd(_mm256_cmp_pd(enter, first, _CMP_LT_OQ),
+													   _mm256_cmp_pd(last, exit, _CMP_LT_OQ)),
+										 _mm256_cmp_pd(first, last, _CMP_EQ_OQ));
+		__m256d hit = _mm256_or_pd(_mm256_cmp_pd(first, last, _CMP_LT_OQ), touching);
+		mask |= static_cast<uint32_t>(_mm256_movemask_pd(hit)) << lane;
+	}
+
+#elif defined(CONFLICT_KERNEL_SSE2)
+	// SSE2 has no blend: select with and/andnot/or
+	struct Select {
+		static __m128d apply(__m128d condition, __m128d ifTrue, __m128d ifFalse) {
+			return _mm_or_pd(_mm_and_pd(condition, ifTrue), _mm_andnot_pd(condition, ifFalse));
+		}
+	};
+	const __m128d zero = _mm_setzero_pd();
+	const __m128d end = _mm_set1_pd(horizon);
+	const __m128d positive = _mm_set1_pd(infinity);
+	const __m128d negative = _mm_set1_pd(-infinity);
+	const __m128d sign = _mm_set1_pd(-0.0);
+	for (uint32_t lane = 0; lane < CONFLICT_BLOCK; lane += 2) {
+		__m128d enter = negative;
+		__m128d exit = positive;
+		for (int axis = 0; axis < 3; ++axis) {
+			__m128d dp = _mm_sub_pd(_mm_loadu_pd(others[axis] + lane), _mm_set1_pd(self[axis]));
+			__m128d dv = _mm_sub_pd(_mm_loadu_pd(others[axis + 3] + lane), _mm_set1_pd(self[axis + 3]));
+			__m128d c = _mm_set1_pd(constraint[axis]);
+			__m128d t1 = _mm_div_pd(_mm_sub_pd(_mm_set1_pd(-constraint[axis]), dp), dv);
+			__m128d t2 = _mm_div_pd(_mm_sub_pd(c, dp), dv);
+			__m128d low = _mm_min_pd(t1, t2);
+			__m128d high = _mm_max_pd(t1, t2);
+
+			// A stationary axis is either always inside or never
+			__m128d stationary = _mm_cmpeq_pd(dv, zero);
+			__m128d inside = _mm_cmplt_pd(_mm_andnot_pd(sign, dp), c);
+			low = Select::apply(stationary, Select::apply(inside, negative, positive), low);
+			high = Select::apply(stationary, Select::apply(inside, positive, negative), high);
+
+			enter = _mm_max_pd(enter, low);
+			exit = _mm_min_pd(exit, high);
+		}
+		__m128d first = _mm_max_pd(enter, zero);
+		__m128d last = _mm_min_pd(exit, end);
+		__m128d touching = _mm_and_pd(_mm_and_pd(_mm_cmplt_pd(enter, first), _mm_cmplt_pd(last, exit)),
+									  _mm_cmpeq_pd(first, last));
+		__m128d hit = _mm_or_pd(_mm_cmplt_pd(first, last), touching);
+		mask |= static_cast<uint32_t>(_mm_movemask_pd(hit)) << lane;
+	}
+
+#elif defined(CONFLICT_KERNEL_NEON)
+	const float64x2_t zero = vdupq_n_f64(0);
+	const float64x2_t end = vdupq_n_f64(horizon);
+	const float64x2_t positive = vdupq_n_f64(infinity);
+	const float64x2_t negative = vdupq_n_f64(-infinity);
+	for (uint32_t lane = 0; lane < CONFLICT_BLOCK; lane += 2) {
+		float64x2_t enter = negative;
+		float64x2_t exit = positive;
+		for (int axis = 0; axis < 3; ++axis) {
+			float64x2_t dp = vsubq_f64(vld1q_f64(others[axis] + lane), vdupq_n_f64(self[axis]));
+			float64x2_t dv = vsubq_f64(vld1q_f64(others[axis + 3] + lane), vdupq_n_f64(self[axis + 3]));
+			float64x2_t c = vdupq_n_f64(constraint[axis]);
+			float64x2_t t1 = vdivq_f64(vsubq_f64(vdupq_n_f64(-constraint[axis]), dp), dv);
+			float64x2_t t2 = vdivq_f64(vsubq_f64(c, dp), dv);
+			float64x2_t low = vminq_f64(t1, t2);
+			float64x2_t high = vmaxq_f64(t1, t2);
+
+			// A stationary axis is either always inside or never
+			uint64x2_t stationary = vceqq_f64(dv, zero);
+			uint64x2_t inside = vcltq_f64(vabsq_f64(dp), c);
+			low = vbslq_f64(stationary, vbslq_f64(inside, negative, positive), low);
+			high = vbslq_f64(stationary, vbslq_f64(inside, positive, negative), high);
+
+			enter = vmaxq_f64(enter, low);
+			exit = vminq_f64(exit, high);
+		}
+		float64x2_t first = vmaxq_f64(enter, zero);
+		float64x2_t last = vminq_f64(exit, end);
+		uint64x2_t touching = vandq_u64(vandq_u64(vcltq_f64(enter, first), vcltq_f64(last, exit)),
+										vceqq_f64(first, last));
+		uint64x2_t hit = vorrq_u64(vcltq_f64(first, last), touching);
+		mask |= static_cast<uint32_t>((vgetq_lane_u64(hit, 0) & 1) | ((vgetq_lane_u64(hit, 1) & 1) << 1)) << lane;
+	}
+
+#else
+	for (uint32_t lane = 0; lane < CONFLICT_BLOCK; ++lane) {
+		const double dp[3] = {others[0][lane] - self[0], others[1][lane] - self[1], others[2][lane] - self[2]};
+		const double dv[3] = {others[3][lane] - self[3], others[4][lane] - self[4], others[5][lane] - self[5]};
+		ConflictResult result;
+		if (sweptConflict(dp, dv, separation, horizon, result)) {
+			mask |= 1u << lane;
+		}
+	}
+	(void)constraint;
+	(void)infinity;
+#endif
+
+	return mask;
+}
+
+// Plane i's state in blockMask's order
+void stateOf(const PlaneView& planes, uint32_t i, double state[STATE_COUNT]) {
+	for (int s = 0; s < STATE_COUNT; ++s) {
+		state[s] = planes.value(static_cast<PlaneColumn>(COLUMN_X + s), i);
+	}
+}
+
+uint32_t laneMask(uint32_t count) {
+	return count >= 32 ? ~0u : (1u << count) - 1;
+}
+
+}
+
+uint32_t conflictMask(const PlaneView& planes, uint32_t i, uint32_t first, uint32_t count,
+					  const Separation& separation, double horizon) {
+	double self[STATE_COUNT];
+	stateOf(planes, i, self);
+
+	// A full block of a columnar view is read in place
+	const double* others[STATE_COUNT];
+	if (count == CONFLICT_BLOCK && planes.isColumnar()) {
+		for (int s = 0; s < STATE_COUNT; ++s) {
+			others[s] = planes.column(static_cast<PlaneColumn>(COLUMN_X + s)) + first;
+		}
+		return blockMask(others, self, separation, horizon);
+	}
+
+	// Otherwise gather it into a padded block
+	uint32_t indices[CONFLICT_BLOCK];
+	for (uint32_t k = 0; k < count; ++k) {
+		indices[k] = first + k;
+	}
+	return conflictMask(planes, i, indices, count, separation, horizon);
+}
+
+uint32_t conflictMask(const PlaneView& planes, uint32_t i, const uint32_t* indices, uint32_t count,
+					  const Separation& separation, double horizon) {
+	double self[STATE_COUNT];
+	stateOf(planes, i, self);
+
+	// Gather the others into a padded block
+	double block[STATE_COUNT][CONFLICT_BLOCK] = {};
+	const double* others[STATE_COUNT];
+	for (int s = 0; s < STATE_COUNT; ++s) {
+		PlaneColumn column = static_cast<PlaneColumn>(COLUMN_X + s);
+		for (uint32_t k = 0; k < count; ++k) {
+			block[s][k] = planes.value(column, indices[k]);
+		}
+		others[s] = block[s];
+	}
+	return blockMask(others, self, separation, horizon) & laneMask(count);
+}
+
+const char* conflictKernelIsa() {
+#if defined(CONFLICT_KERNEL_AVX)
+	return "AVX";
+#elif defined(CONFLICT_KERNEL_SSE2)
+	return "SSE2";
+#elif defined(CONFLICT_KERNEL_NEON)
+	return "NEON";
+#else
+	return "scalar";
+#endif
+}
@@ -0,0 +1,35 @@
+/*
+ * Batched form of sweptConflict: one aircraft against a block of up to
+ * CONFLICT_BLOCK others, returning a bitmask of the ones it loses separation
+ * with during [0, horizon].
+ *
+ * The block is processed in SIMD lanes over SoA data: AVX (4 lanes) or SSE2
+ * (2 lanes) on x86, NEON (2 lanes) on aarch64, and a scalar loop elsewhere or
+ * when built with CONFLICT_KERNEL_SCALAR. Every path evaluates the same interval
+ * arithmetic as sweptConflict, so the masks match it exactly; only the yes/no is
+ * computed here, and callers ask sweptConflict for the times of the few hits.
+ */
+
+#ifndef CONFLICTKERNEL_H_
+#define CONFLICTKERNEL_H_
+
+#include <cstdint>
+#include "ConflictDetection.h"
+#include "SharedAirspace.h"
+
+// Aircraft tested against one aircraft per call
+const uint32_t CONFLICT_BLOCK = 8;
+
+// Bit k is set if plane i conflicts with plane first + k, for k < count <= CONFLICT_BLOCK.
+// Columns are read in place when the view is columnar.
+uint32_t conflictMask(const PlaneView& planes, uint32_t i, uint32_t first, uint32_t count,
+					  const Separation& separation, double horizon);
+
+// Bit k is set if plane i conflicts with plane indices[k], for k < count <= CONFLICT_BLOCK
+uint32_t conflictMask(const PlaneView& planes, uint32_t i, const uint32_t* indices, uint32_t count,
+					  const Separation& separation, double horizon);
+
+// Instruction set the kernel was built for
+const char* conflictKernelIsa();
+
+#endif /* CONFLICTKERNEL_H_ */
@@ -0,0 +1,290 @@
+#include "ConflictTable.h"
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "ReadBackOff.h"
+
+size_t conflictTableSize(uint32_t capacity, uint32_t advisoryCapacity) {
+	return sizeof(ConflictTable) + static_cast<size_t>(capacity) * sizeof(msg_alert)
+		   + static_cast<size_t>(advisoryCapacity) * sizeof(msg_advisory);
+}
+
+namespace {
+
+const msg_alert* alertsOf(const ConflictTable* table) {
+	return reinterpret_cast<const msg_alert*>(reinterpret_cast<const char*>(table) + sizeof(ConflictTable));
+}
+
+// Advisories follow the alerts, so they move when the alert capacity grows
+const msg_advisory* advisoriesOf(const ConflictTable* table, uint32_t capacity) {
+	return reinterpret_cast<const msg_advisory*>(reinterpret_cast<const char*>(table) + conflictTableSize(capacity, 0));
+}
+
+// `capacity` doubled until it holds `needed` entries
+uint32_t grownCapacity(uint32_t capacity, size_t needed) {
+	capacity = std::max<uint32_t>(capacity, 1);
+	while (capacity < needed) {
+		capacity *= 2;
+	}
+	return capacity;
+}
+
+}
+
+ConflictTableWriter::ConflictTableWriter()
+	: shm_fd(-1), table(nullptr), mappedCapacity(0), mappedAdvisoryCapacity(0), reportNumber(0) {}
+
+ConflictTableWriter::~ConflictTableWriter() {
+	close();
+}
+
+bool ConflictTableWriter::open(uint32_t initialCapacity, uint32_t initialAdvisoryCapacity) {
+	shm_fd = shm_open(CONFLICT_SHM_NAME, O_CREAT | O_RDWR, 0666);
+	if (shm_fd == -1) {
+		std::cerr << "Failed to open conflict table shared memory" << std::endl;
+		return false;
+	}
+
+	if (!grow(std::max<uint32_t>(initialCapacity, 1), std::max<uint32_t>(initialAdvisoryCapacity, 1))) {
+		close();
+		return false;
+	}
+
+	// Readers only open a segment with the current version, so hide it until the
+	// table holds an empty report
+	table->layout_version = 0;
+	uint32_t sequence = table->sequence.load(std::memory_order_relaxed);
+	table->sequence.store(sequence | 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	table->capacity.store(mappedCapacity, std::memory_order_relaxed);
+	table->advisory_capacity.store(mappedAdvisoryCapacity, std::memory_order_relaxed);
+	table->count = 0;
+	table->advisory_count = 0;
+	table->report_number = 0;
+	table->frame_number = 0;
+	table->timestamp = 0;
+	reportNumber = 0;
+	table->sequence.store((sequence | 1) + 1, std::memory_order_release);
+	table->layout_version = CONFLICT_TABLE_LAYOUT_VERSION;
+	return true;
+}
+
+void ConflictTableWriter::close() {
+	if (table) {
+		munmap(table, conflictTableSize(mappedCapacity, mappedAdvisoryCapacity));
+		table = nullptr;
+		mappedCapacity = 0;
+		mappedAdvisoryCapacity = 0;
+	}
+	if (shm_fd != -1) {
+		::close(shm_fd);
+		shm_fd = -1;
+	}
+}
+
+// Maps the segment with room for the given entries. The file only grows, so
+// readers still holding the old mapping never fault.
+bool ConflictTableWriter::grow(uint32_t capacity, uint32_t advisoryCapacity) {
+	size_t size = conflictTableSize(capacity, advisoryCapacity);
+	struct stat shm_stat;
+	if (fstat(shm_fd, &shm_stat) == -1 || (size_t)shm_stat.st_size < size) {
+		if (ftruncate(shm_fd, size) == -1) {
+			std::cerr << "Failed to set conflict table size" << std::endl;
+			return false;
+		}
+	}
+
+	void* mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
+	if (mapping == MAP_FAILED) {
+		std::cerr << "Failed to map conflict table" << std::endl;
+		return false;
+	}
+
+	if (table) {
+		munmap(table, conflictTableSize(mappedCapacity, mappedAdvisoryCapacity));
+	}
+	table = static_cast<ConflictTable*>(mapping);
+	mappedCapacity = capacity;
+	mappedAdvisoryCapacity = advisoryCapacity;
+	return true;
+}
+
+uint64_t ConflictTableWriter::publish(uint64_t frameNumber, uint64_t timestamp, const std::vector<msg_alert>& alerts,
+									  const std::vector<msg_advisory>& advisories) {
+	if (!table) {
+		return 0;
+	}
+
+	if (alerts.size() > mappedCapacity || advisories.size() > mappedAdvisoryCapacity) {
+		if (!grow(grownCapacity(mappedCapacity, alerts.size()), grownCapacity(mappedAdvisoryCapacity, advisories.size()))) {
+			return 0;
+		}
+	}
+
+	uint32_t sequence = table->sequence.load(std::memory_order_relaxed);
+	table->sequence.store(sequence + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	table->capacity.store(mappedCapacity, std::memory_order_relaxed);
+	table->advisory_capacity.store(mappedAdvisoryCapacity, std::memory_order_relaxed);
+	table->count = alerts.size();
+	table->advisory_count = advisories.size();
+	table->report_number = ++reportNumber;
+	table->frame_number = frameNumber;
+	table->timestamp = timestamp;
+	if (!alerts.empty()) {
+		std::memcpy(const_cast<msg_alert*>(alertsOf(table)), alerts.data(), alerts.size() * sizeof(msg_alert));
+	}
+	if (!advisories.empty()) {
+		std::memcpy(const_cast<msg_advisory*>(advisoriesOf(table, mappedCapacity)), advisories.data(),
+					advisories.size() * sizeof(msg_advisory));
+	}
+
+	table->sequence.store(sequence + 2, std::memory_order_release);
+	return reportNumber;
+}
+
+uint32_t ConflictTableWriter::getCapacity() const {
+	return mappedCapacity;
+}
+
+uint32_t ConflictTableWriter::getAdvisoryCapacity() const {
+	return mappedAdvisoryCapacity;
+}
+
+
+ConflictTableReader::ConflictTableReader() : shm_fd(-1), table(nullptr), mappedCapacity(0), mappedAdvisoryCapacity(0) {}
+
+ConflictTableReader::~ConflictTableReader() {
+	close();
+}
+
+bool ConflictTableReader::open() {
+	shm_fd = shm_open(CONFLICT_SHM_NAME, O_RDONLY, 0666);
+	if (shm_fd == -1) {
+		return false;
+	}
+
+	// Map just the header first, then as many entries as it says
+	if (!remap(0, 0)) {
+		close();
+		return false;
+	}
+
+	if (table->layout_version != CONFLICT_TABLE_LAYOUT_VERSION) {
+		std::cerr << "Conflict table layout version " << table->layout_version
+				  << " does not match expected " << CONFLICT_TABLE_LAYOUT_VERSION << std::endl;
+		close();
+		return false;
+	}
+
+	if (!remap(table->capacity.load(std::memory_order_acquire), table->advisory_capacity.load(std::memory_order_acquire))) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+void ConflictTableReader::close() {
+	if (table) {
+		munmap(const_cast<ConflictTable*>(table), conflictTableSize(mappedCapacity, mappedAdvisoryCapacity));
+		table = nullptr;
+		mappedCapacity = 0;
+		mappedAdvisoryCapacity = 0;
+	}
+	if (shm_fd != -1) {
+		::close(shm_fd);
+		shm_fd = -1;
+	}
+}
+
+bool ConflictTableReader::isOpen() const {
+	return table != nullptr;
+}
+
+bool ConflictTableReader::remap(uint32_t capacity, uint32_t advisoryCapacity) {
+	// Never map past the end of the file; that would fault on access
+	size_t size = conflictTableSize(capacity, advisoryCapacity);
+	struct stat shm_stat;
+	if (fstat(shm_fd, &shm_stat) == -1 || (size_t)shm_stat.st_size < size) {
+		return false;
+	}
+
+	void* mapping = mmap(NULL, size, PROT_READ, MAP_SHARED, shm_fd, 0);
+	if (mapping == MAP_FAILED) {
+		return false;
+	}
+
+	if (table) {
+		munmap(const_cast<ConflictTable*>(table), conflictTableSize(mappedCapacity, mappedAdvisoryCapacity));
+	}
+	table = static_cast<const ConflictTable*>(mapping);
+	mappedCapacity = capacity;
+	mappedAdvisoryCapacity = advisoryCapacity;
+	return true;
+}
+
+bool ConflictTableReader::read(ConflictReport& report) {
+	return copy(report, true);
+}
+
+bool ConflictTableReader::readAdvisories(ConflictReport& report) {
+	return copy(report, false);
+}
+
+bool ConflictTableReader::copy(ConflictReport& report, bool withAlerts) {
+	if (!table) {
+		return false;
+	}
+
+	uint32_t attempt = 0;
+	while (true) {
+		uint32_t sequence = table->sequence.load(std::memory_order_acquire);
+		if (sequence & 1) {
+			if (!backOff(attempt)) {
+				return false;
+			}
+			continue;
+		}
+
+		// The advisories sit after `capacity` alerts, so the mapping has to match the
+		// capacities exactly, not just be large enough
+		uint32_t capacity = table->capacity.load(std::memory_order_relaxed);
+		uint32_t advisoryCapacity = table->advisory_capacity.load(std::memory_order_relaxed);
+		if (capacity != mappedCapacity || advisoryCapacity != mappedAdvisoryCapacity) {
+			if (table->sequence.load(std::memory_order_acquire) != sequence) {
+				continue;
+			}
+			if (!remap(capacity, advisoryCapacity)) {
+				return false;
+			}
+			continue;
+		}
+
+		uint32_t count = withAlerts ? std::min(table->count, mappedCapacity) : 0;
+		uint32_t advisoryCount = std::min(table->advisory_count, mappedAdvisoryCapacity);
+		report.report_number = table->report_number;
+		report.frame_number = table->frame_number;
+		report.timestamp = table->timestamp;
+		report.alerts.resize(count);
+		if (count) {
+			std::memcpy(report.alerts.data(), alertsOf(table), count * sizeof(msg_alert));
+		}
+		report.advisories.resize(advisoryCount);
+		if (advisoryCount) {
+			std::memcpy(report.advisories.data(), advisoriesOf(table, mappedCapacity), advisoryCount * sizeof(msg_advisory));
+		}
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (table->sequence.load(std::memory_order_relaxed) == sequence) {
+			return report.report_number != 0;
+		}
+		if (!backOff(attempt)) {
+			return false;
+		}
+	}
+}
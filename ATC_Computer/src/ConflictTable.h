@@ -0,0 +1,133 @@
+/*
+ * Shared memory table of the conflict alerts the ComputerSystem holds after
+ * its last evaluation, read by the Display.
+ *
+ * COLLISION_DETECTED messages only carry the alerts that changed (see
+ * AlertTracker), and only as many as fit in one message. The full set is
+ * kept in this segment, so the Display can resynchronise from it when the
+ * changes did not fit or it missed a message. The resolution advisories of
+ * the same evaluation are published alongside; the Display reads those on
+ * every redraw. The segment is a ConflictTable header followed by
+ * `capacity` msg_alert entries, sorted by plane pair, then
+ * `advisory_capacity` msg_advisory entries, by cluster and rank.
+ *
+ * The whole table is one seqlock: `sequence` is odd while the ComputerSystem
+ * rewrites it, and readers copy the header and entries out and retry if the
+ * sequence moved, so a reader always gets one complete report. The segment
+ * only grows; it is extended before the capacities are raised, so a reader
+ * can always map as many entries as the header claims.
+ */
+
+#ifndef CONFLICTTABLE_H_
+#define CONFLICTTABLE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Msg_structs.h"
+
+// Shared memory name (same in ComputerSystem and Display)
+#define CONFLICT_SHM_NAME "/tmp/AH_40247851_40228573_Conflict_shm"
+
+// Bump whenever the header or entry layout changes
+const uint32_t CONFLICT_TABLE_LAYOUT_VERSION = 4;
+
+// Entries the ComputerSystem maps on start-up; the segment grows past this on demand
+const uint32_t CONFLICT_TABLE_INITIAL_CAPACITY = 256;
+const uint32_t CONFLICT_TABLE_INITIAL_ADVISORY_CAPACITY = 64;
+
+// Segment header, followed in memory by msg_alert entries[capacity] and
+// msg_advisory advisories[advisory_capacity]
+struct ConflictTable {
+	uint32_t layout_version;			// CONFLICT_TABLE_LAYOUT_VERSION once the ComputerSystem has set the segment up
+	std::atomic<uint32_t> sequence;		// Seqlock counter: odd while the ComputerSystem writes
+	std::atomic<uint32_t> capacity;		// Alerts the segment holds
+	uint32_t count;						// Alerts in the current report
+	std::atomic<uint32_t> advisory_capacity;	// Advisories the segment holds
+	uint32_t advisory_count;			// Advisories in the current report
+	uint64_t report_number;				// Evaluations published so far
+	uint64_t frame_number;				// Radar frame the report was computed from
+	uint64_t timestamp;					// Simulation time of that frame in ms
+};
+
+// Data of a COLLISION_DETECTED message: this header, then `count` msg_alert
+// transitions that turn report `base_report` into `report_number`
+typedef struct {
+	uint64_t report_number;
+	uint64_t base_report;	// Report of the previous message
+	uint32_t count;			// ALERT_DELTA_OVERFLOW: too many to send, read the table
+} AlertDelta;
+
+const uint32_t ALERT_DELTA_OVERFLOW = UINT32_MAX;
+
+// Transitions that fit in one message
+const uint32_t ALERT_DELTA_CAPACITY = (sizeof(Message_inter_process::data) - sizeof(AlertDelta)) / sizeof(msg_alert);
+
+// A report copied out of the table
+struct ConflictReport {
+	uint64_t report_number = 0;
+	uint64_t frame_number = 0;
+	uint64_t timestamp = 0;
+	std::vector<msg_alert> alerts;
+	std::vector<msg_advisory> advisories;
+};
+
+// Bytes of a segment holding `capacity` alerts and `advisoryCapacity` advisories
+size_t conflictTableSize(uint32_t capacity, uint32_t advisoryCapacity);
+
+// ComputerSystem side: owns the segment and publishes every evaluation into it
+class ConflictTableWriter {
+public:
+	ConflictTableWriter();
+	~ConflictTableWriter();
+
+	bool open(uint32_t initialCapacity = CONFLICT_TABLE_INITIAL_CAPACITY,
+			  uint32_t initialAdvisoryCapacity = CONFLICT_TABLE_INITIAL_ADVISORY_CAPACITY);
+	void close();
+
+	// Replace the table with `alerts` and `advisories`, growing the segment first if
+	// they do not fit; returns the new report number, or 0 if the table is not open
+	uint64_t publish(uint64_t frameNumber, uint64_t timestamp, const std::vector<msg_alert>& alerts,
+					 const std::vector<msg_advisory>& advisories);
+
+	uint32_t getCapacity() const;
+	uint32_t getAdvisoryCapacity() const;
+
+private:
+	bool grow(uint32_t capacity, uint32_t advisoryCapacity);
+
+	int shm_fd;
+	ConflictTable* table;
+	uint32_t mappedCapacity;
+	uint32_t mappedAdvisoryCapacity;
+	uint64_t reportNumber;
+};
+
+// Display side: read-only mapping, remapped when the table grows
+class ConflictTableReader {
+public:
+	ConflictTableReader();
+	~ConflictTableReader();
+
+	bool open();
+	void close();
+	bool isOpen() const;
+
+	// Copy the latest complete report; false if nothing has been published yet,
+	// or if no complete report could be read within a bounded number of attempts
+	bool read(ConflictReport& report);
+	// The same, leaving out the alerts
+	bool readAdvisories(ConflictReport& report);
+
+private:
+	bool copy(ConflictReport& report, bool withAlerts);
+	bool remap(uint32_t capacity, uint32_t advisoryCapacity);
+
+	int shm_fd;
+	const ConflictTable* table;
+	uint32_t mappedCapacity;
+	uint32_t mappedAdvisoryCapacity;
+};
+
+#endif /* CONFLICTTABLE_H_ */
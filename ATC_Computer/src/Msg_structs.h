@@ -1,6 +1,8 @@
 #pragma once
 #include <atomic>
 #include <array>
+#include <cstddef>
+#include <cstdint>
 
 enum class MessageType {
     ENTER_AIRSPACE,
@@ -26,9 +28,21 @@ struct Message {
 
 typedef struct {
 	int id;
+	int flags;  // PLANE_INFO_* bits set by the Radar
 	double PositionX, PositionY, PositionZ, VelocityX, VelocityY, VelocityZ;
 } msg_plane_info;
 
+// msg_plane_info::flags
+const int PLANE_INFO_STALE = 0x1;  // Aircraft missed the sweep deadline; position is extrapolated from the last one known
+const int PLANE_INFO_MANEUVER_SHIFT = 8;  // Bits from here up count the commands the aircraft has applied
+
+// Reply to REQUEST_POSITION. The state travels in the reply itself; a pointer in
+// Message::data would point into the aircraft's stack once the reply is sent.
+struct Message_position_reply {
+	Message message;  // POSITION_UPDATE
+	msg_plane_info info;
+};
+
 typedef struct {
 	int ID;
 	double VelocityX, VelocityY, VelocityZ;
@@ -39,15 +53,63 @@ typedef struct {
 	double x,y,z;
 } msg_change_position;
 
-// Shared memory structure
-struct SharedMemory {
-    msg_plane_info plane_data[100];
-    int count;  // Keep track of the number of planes in the buffer
-    std::atomic<bool> is_empty;  // New flag to indicate if there are no planes in the buffer
-    bool start;
-    uint64_t timestamp;  // Timestamp of the last write
+// One conflict found by the collision check
+typedef struct {
+	int plane1;
+	int plane2;
+	float conflictTime;		// Seconds after the frame until separation is lost (0: already lost)
+	float closestApproach;	// Seconds after the frame until the two are closest
+	int severity;			// Lookahead horizons the conflict falls within; highest for the shortest
+} msg_collision;
+
+// Most lookahead horizons the collision check grades conflicts with
+const int MAX_CONFLICT_HORIZONS = 8;
+
+// Data of a CHANGE_TIME_CONSTRAINT_COLLISIONS message
+typedef struct {
+	int count;
+	float horizons[MAX_CONFLICT_HORIZONS];	// Seconds, any order
+} msg_change_horizons;
+
+// Lifecycle of a conflict alert, per pair of aircraft
+enum AlertState {
+	ALERT_NEW,			// First evaluation that found the conflict
+	ALERT_ONGOING,		// Still in conflict, or its prediction or severity moved
+	ALERT_ESCALATED,	// Separation is lost within ALERT_ESCALATION_S
+	ALERT_RESOLVED		// No longer in conflict; the alert is dropped
 };
 
+// One alert, or one alert transition in a COLLISION_DETECTED message
+typedef struct {
+	int plane1;
+	int plane2;
+	int state;				// AlertState
+	int severity;			// As in msg_collision
+	float conflictTime;		// Seconds after `updated` until separation is lost (0: already lost)
+	float closestApproach;	// Seconds after `updated` until the two are closest
+	uint64_t firstSeen;		// Simulation time in ms of the frame that raised the alert
+	uint64_t updated;		// Simulation time in ms of the frame the times were predicted from
+} msg_alert;
+
+// Kind of maneuver a resolution advisory proposes
+enum AdvisoryManeuver {
+	ADVISORY_HEADING,	// Turn by `change` degrees, counter-clockwise seen from above
+	ADVISORY_ALTITUDE,	// Climb by `change` (negative: descend)
+	ADVISORY_SPEED		// Scale the ground speed by 1 + `change`
+};
+
+// One resolution advisory for a cluster of conflicting aircraft
+typedef struct {
+	int cluster;		// Advisories for the same conflicts share this; 1 is the most urgent cluster
+	int rank;			// 1 is the best advisory of its cluster
+	int maneuver;		// AdvisoryManeuver
+	float change;
+	int conflicts;		// Conflicts in the cluster
+	int resolved;		// Of those, the ones the maneuver clears
+	int introduced;		// New conflicts it would cause
+	msg_change_heading command;	// Operator command: REQUEST_CHANGE_ALTITUDE for ADVISORY_ALTITUDE, else REQUEST_CHANGE_OF_HEADING
+} msg_advisory;
+
 struct Message_inter_process {
 	bool header; //intra process; 1: interprocess
 	MessageType type;
@@ -12,6 +12,7 @@
 
 
 #define COMMS_CHANNEL_NAME "AH_40247851_40228573_Comms"
+#define COMPUTER_CHANNEL_NAME "AH_40247851_40228573_Computer"
 
 OperatorConsole::OperatorConsole() : exit(false) {
 
@@ -31,7 +32,8 @@ void OperatorConsole::HandleConsoleInputs() {
     std::cout << "  1. heading <planeID> <velX> <velY> <velZ> - Change plane heading\n";
     std::cout << "  2. position <planeID> <x> <y> <z> - Change plane position\n";
     std::cout << "  3. altitude <planeID> <z> - Change plane altitude\n";
-    std::cout << "  4. exit - Exit the console\n\n\n";
+    std::cout << "  4. horizon <seconds> [<seconds> ...] - Set the collision lookahead horizons\n";
+    std::cout << "  5. exit - Exit the console\n\n\n";
 
 
     while (!exit) {
@@ -197,9 +199,53 @@ void OperatorConsole::HandleConsoleInputs() {
                 std::cerr << "Invalid altitude command format. Usage: altitude <planeID> <z>\n";
             }
         }
+        else if (command == "horizon") {
+            msg_change_horizons horizon_data;
+            memset(&horizon_data, 0, sizeof(horizon_data));
+            float horizon;
+            while (horizon_data.count < MAX_CONFLICT_HORIZONS && iss >> horizon) {
+                horizon_data.horizons[horizon_data.count++] = horizon;
+            }
+
+            if (horizon_data.count > 0 && iss.eof()) {
+                // Horizons are the Computer System's own setting, not an aircraft command
+                int computer_channel = name_open(COMPUTER_CHANNEL_NAME, 0);
+
+                if (computer_channel == -1) {
+                    std::cerr << "Failed to open channel to Computer System\n";
+                    std::cerr << "  Error: " << strerror(errno) << "\n";
+                    continue;
+                }
+
+                Message_inter_process msg;
+                memset(&msg, 0, sizeof(msg));
+
+                msg.header = true;  // Inter-process
+                msg.type = MessageType::CHANGE_TIME_CONSTRAINT_COLLISIONS;
+                msg.planeID = -1;
+
+                msg.dataSize = sizeof(msg_change_horizons);
+                std::memcpy(msg.data.data(), &horizon_data, sizeof(msg_change_horizons));
+
+                int reply = -1;
+                if (MsgSend(computer_channel, &msg, sizeof(msg), &reply, sizeof(reply)) == -1) {
+                    std::cerr << "Failed to send message to Computer System\n";
+                    std::cerr << "  Error: " << strerror(errno) << "\n";
+                } else if (reply != 0) {
+                    std::cerr << "Computer System rejected the horizons; they must be positive\n";
+                } else {
+                    std::cout << "Collision horizons sent, applied from the next frame\n";
+                }
+
+                name_close(computer_channel);
+            } else {
+                std::cerr << "Invalid horizon command format. Usage: horizon <seconds> [<seconds> ...] (at most "
+                          << MAX_CONFLICT_HORIZONS << ")\n";
+            }
+        }
         else {
             std::cerr << "Unknown command: " << command << "\n";
-            std::cerr << "Available commands: heading, position, altitude, exit\n";
+            std::cerr << "Available commands: heading, position, altitude, horizon, exit\n";
         }
     }
 }
@@ -0,0 +1,355 @@
+#include "ResolutionAdvisor.h"
+#include <algorithm>
+#include <cmath>
+#include "ConflictKernel.h"
+
+namespace {
+
+const uint32_t MANEUVER_COUNT = sizeof(ADVISORY_MANEUVERS) / sizeof(ADVISORY_MANEUVERS[0]);
+const uint32_t NO_CLUSTER = UINT32_MAX;
+
+// Largest ground speed factor and altitude change among the maneuvers; turns keep the speed
+double maxSpeedFactor() {
+	double factor = 1;
+	for (const AdvisoryCandidate& candidate : ADVISORY_MANEUVERS) {
+		if (candidate.maneuver == ADVISORY_SPEED) {
+			factor = std::max(factor, 1.0 + candidate.change);
+		}
+	}
+	return factor;
+}
+
+double maxClimb() {
+	double climb = 0;
+	for (const AdvisoryCandidate& candidate : ADVISORY_MANEUVERS) {
+		if (candidate.maneuver == ADVISORY_ALTITUDE) {
+			climb = std::max(climb, std::fabs(static_cast<double>(candidate.change)));
+		}
+	}
+	return climb;
+}
+
+const double MAX_SPEED_FACTOR = maxSpeedFactor();
+const double MAX_CLIMB = maxClimb();
+
+uint32_t findRoot(std::vector<uint32_t>& parent, uint32_t i) {
+	while (parent[i] != i) {
+		parent[i] = parent[parent[i]];
+		i = parent[i];
+	}
+	return i;
+}
+
+}
+
+ResolutionAdvisor::ResolutionAdvisor(const Separation& sep, double lowest, double highest, unsigned workerThreads, double budget)
+	: separation(sep), minAltitude(lowest), maxAltitude(highest), workerCount(std::max(workerThreads, 1u)), budgetMs(budget), horizon(0), nextMember(0),
+	  checkedTrials(0), advisedClusters(0), pool(workerCount) {
+	scratch.resize(workerCount);
+}
+
+void ResolutionAdvisor::advise(const PlaneView& framePlanes, const std::vector<msg_collision>& conflicts, double lookahead,
+							   std::vector<msg_advisory>& advisories) {
+	deadline = std::chrono::steady_clock::now()
+			   + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double, std::milli>(budgetMs));
+	planes = framePlanes;
+	horizon = lookahead;
+	advisories.clear();
+	findClusters(conflicts);
+
+	outcomes.assign(members.size() * MANEUVER_COUNT, Outcome{false, 0, 0});
+	nextMember.store(0, std::memory_order_relaxed);
+	if (!members.empty()) {
+		pool.run([this](unsigned index) { checkMembers(index); });
+	}
+
+	// Rank what was checked in time, cluster by cluster
+	checkedTrials = 0;
+	advisedClusters = 0;
+	struct Ranked {
+		uint32_t plane;
+		uint32_t candidate;
+		const Outcome* outcome;
+	};
+	std::vector<Ranked> ranked;
+	for (uint32_t c = 0; c < clusters.size(); ++c) {
+		const Cluster& cluster = clusters[c];
+		ranked.clear();
+		bool checked = false;
+		for (uint32_t m = cluster.firstMember; m < cluster.firstMember + cluster.memberCount; ++m) {
+			for (uint32_t k = 0; k < MANEUVER_COUNT; ++k) {
+				const Outcome& outcome = outcomes[m * MANEUVER_COUNT + k];
+				if (outcome.checked) {
+					checked = true;
+					++checkedTrials;
+					if (outcome.resolved > outcome.introduced) {
+						ranked.push_back(Ranked{members[m], k, &outcome});
+					}
+				}
+			}
+		}
+		advisedClusters += checked;
+
+		std::sort(ranked.begin(), ranked.end(), [&cluster](const Ranked& a, const Ranked& b) {
+			int leftA = cluster.conflicts - a.outcome->resolved + a.outcome->introduced;
+			int leftB = cluster.conflicts - b.outcome->resolved + b.outcome->introduced;
+			if (leftA != leftB) {
+				return leftA < leftB;
+			}
+			float costA = ADVISORY_MANEUVERS[a.candidate].cost;
+			float costB = ADVISORY_MANEUVERS[b.candidate].cost;
+			if (costA != costB) {
+				return costA < costB;
+			}
+			return a.candidate != b.candidate ? a.candidate < b.candidate : a.plane < b.plane;
+		});
+
+		for (uint32_t r = 0; r < ranked.size() && r < ADVISORIES_PER_CLUSTER; ++r) {
+			msg_advisory advisory = {};
+			advisory.cluster = c + 1;
+			advisory.rank = r + 1;
+			advisory.maneuver = ADVISORY_MANEUVERS[ranked[r].candidate].maneuver;
+			advisory.change = ADVISORY_MANEUVERS[ranked[r].candidate].change;
+			advisory.conflicts = cluster.conflicts;
+			advisory.resolved = ranked[r].outcome->resolved;
+			advisory.introduced = ranked[r].outcome->introduced;
+			maneuver(ranked[r].plane, ranked[r].candidate, advisory.command);
+			advisories.push_back(advisory);
+		}
+	}
+}
+
+// Conflicts sharing an aircraft end up in one cluster; clusters are sorted by their
+// earliest loss of separation, and the members of each by plane index
+void ResolutionAdvisor::findClusters(const std::vector<msg_collision>& conflicts) {
+	uint32_t count = planes.size();
+	clusters.clear();
+	members.clear();
+	parent.resize(count);
+	for (uint32_t i = 0; i < count; ++i) {
+		parent[i] = i;
+	}
+
+	// Partner lists, counted then filled in place
+	partnerStart.assign(count + 1, 0);
+	std::vector<std::pair<uint32_t, uint32_t>> pairs;
+	pairs.reserve(conflicts.size());
+	for (const msg_collision& conflict : conflicts) {
+		int first = planes.find(conflict.plane1);
+		int second = planes.find(conflict.plane2);
+		if (first < 0 || second < 0) {
+			pairs.emplace_back(NO_CLUSTER, NO_CLUSTER);
+			continue;
+		}
+		pairs.emplace_back(first, second);
+		partnerStart[first + 1]++;
+		partnerStart[second + 1]++;
+		parent[findRoot(parent, first)] = findRoot(parent, second);
+	}
+	for (uint32_t i = 0; i < count; ++i) {
+		partnerStart[i + 1] += partnerStart[i];
+	}
+	partners.resize(partnerStart[count]);
+	clusterOf.assign(count, 0);		// Fill position of each plane's list for now
+	for (const auto& pair : pairs) {
+		if (pair.first != NO_CLUSTER) {
+			partners[partnerStart[pair.first] + clusterOf[pair.first]++] = pair.second;
+			partners[partnerStart[pair.second] + clusterOf[pair.second]++] = pair.first;
+		}
+	}
+
+	clusterOf.assign(count, NO_CLUSTER);
+	for (size_t k = 0; k < pairs.size(); ++k) {
+		if (pairs[k].first == NO_CLUSTER) {
+			continue;
+		}
+		uint32_t root = findRoot(parent, pairs[k].first);
+		if (clusterOf[root] == NO_CLUSTER) {
+			clusterOf[root] = clusters.size();
+			clusters.push_back(Cluster{0, 0, 0, conflicts[k].conflictTime});
+		}
+		Cluster& cluster = clusters[clusterOf[root]];
+		cluster.conflicts++;
+		cluster.urgency = std::min(cluster.urgency, conflicts[k].conflictTime);
+	}
+
+	// Most urgent first; ties go to the cluster holding the lowest index
+	std::vector<uint32_t> lowest(clusters.size(), count);
+	for (uint32_t i = 0; i < count; ++i) {
+		if (partnerStart[i + 1] > partnerStart[i]) {
+			std::sort(partners.begin() + partnerStart[i], partners.begin() + partnerStart[i + 1]);
+			uint32_t c = clusterOf[findRoot(parent, i)];
+			clusters[c].memberCount++;
+			lowest[c] = std::min(lowest[c], i);
+		}
+	}
+	std::vector<uint32_t> order(clusters.size());
+	for (uint32_t c = 0; c < order.size(); ++c) {
+		order[c] = c;
+	}
+	std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+		return clusters[a].urgency != clusters[b].urgency ? clusters[a].urgency < clusters[b].urgency : lowest[a] < lowest[b];
+	});
+	std::vector<Cluster> sorted(clusters.size());
+	std::vector<uint32_t> rank(clusters.size());
+	uint32_t firstMember = 0;
+	for (uint32_t r = 0; r < order.size(); ++r) {
+		sorted[r] = clusters[order[r]];
+		sorted[r].firstMember = firstMember;
+		firstMember += sorted[r].memberCount;
+		rank[order[r]] = r;
+	}
+	clusters.swap(sorted);
+
+	// Members in plane order within each cluster
+	members.resize(firstMember);
+	std::vector<uint32_t> filled(clusters.size(), 0);
+	for (uint32_t i = 0; i < count; ++i) {
+		if (partnerStart[i + 1] > partnerStart[i]) {
+			uint32_t c = rank[clusterOf[findRoot(parent, i)]];
+			members[clusters[c].firstMember + filled[c]++] = i;
+		}
+	}
+}
+
+void ResolutionAdvisor::checkMembers(unsigned index) {
+	// The frame plus one spare row at the end
+	Scratch& own = scratch[index];
+	PlaneColumns& probe = own.probe;
+	uint32_t count = planes.size();
+	if (planes.isColumnar()) {
+		probe.id.assign(planes.ids(), planes.ids() + count);
+		probe.flags.assign(count, 0);
+		probe.x.assign(planes.column(COLUMN_X), planes.column(COLUMN_X) + count);
+		probe.y.assign(planes.column(COLUMN_Y), planes.column(COLUMN_Y) + count);
+		probe.z.assign(planes.column(COLUMN_Z), planes.column(COLUMN_Z) + count);
+		probe.vx.assign(planes.column(COLUMN_VX), planes.column(COLUMN_VX) + count);
+		probe.vy.assign(planes.column(COLUMN_VY), planes.column(COLUMN_VY) + count);
+		probe.vz.assign(planes.column(COLUMN_VZ), planes.column(COLUMN_VZ) + count);
+	} else {
+		probe.clear();
+		probe.reserve(count + 1);
+		for (uint32_t i = 0; i < count; ++i) {
+			probe.push_back(planes.at(i));
+		}
+	}
+	probe.push_back(planes.at(0));
+
+	for (size_t m = nextMember.fetch_add(1, std::memory_order_relaxed); m < members.size();
+		 m = nextMember.fetch_add(1, std::memory_order_relaxed)) {
+		if (std::chrono::steady_clock::now() > deadline) {
+			return;
+		}
+		findNearby(members[m], own);
+		for (uint32_t k = 0; k < MANEUVER_COUNT; ++k) {
+			check(members[m], k, own, outcomes[m * MANEUVER_COUNT + k]);
+		}
+	}
+}
+
+// Planes whose path within the horizon comes within separation of anywhere `plane`
+// can be under one of the maneuvers: a turn keeps the ground speed, so it stays
+// inside a square around its position, and altitude changes only shift it up or down
+void ResolutionAdvisor::findNearby(uint32_t plane, Scratch& own) const {
+	const PlaneColumns& frame = own.probe;
+	double reach = std::hypot(frame.vx[plane], frame.vy[plane]) * MAX_SPEED_FACTOR * horizon;
+	double lowX = frame.x[plane] - reach - separation.x;
+	double highX = frame.x[plane] + reach + separation.x;
+	double lowY = frame.y[plane] - reach - separation.y;
+	double highY = frame.y[plane] + reach + separation.y;
+	double climb = frame.vz[plane] * horizon;
+	double lowZ = frame.z[plane] + std::min(climb, 0.0) - MAX_CLIMB - separation.z;
+	double highZ = frame.z[plane] + std::max(climb, 0.0) + MAX_CLIMB + separation.z;
+
+	own.nearby.clear();
+	uint32_t count = planes.size();
+	for (uint32_t j = 0; j < count; ++j) {
+		double endX = frame.x[j] + frame.vx[j] * horizon;
+		double endY = frame.y[j] + frame.vy[j] * horizon;
+		double endZ = frame.z[j] + frame.vz[j] * horizon;
+		if (std::max(frame.x[j], endX) < lowX || std::min(frame.x[j], endX) > highX
+			|| std::max(frame.y[j], endY) < lowY || std::min(frame.y[j], endY) > highY
+			|| std::max(frame.z[j], endZ) < lowZ || std::min(frame.z[j], endZ) > highZ || j == plane) {
+			continue;
+		}
+		own.nearby.push_back(j);
+	}
+}
+
+// The command that flies `plane` through maneuver `candidate`
+void ResolutionAdvisor::maneuver(uint32_t plane, uint32_t candidate, msg_change_heading& command) const {
+	const AdvisoryCandidate& change = ADVISORY_MANEUVERS[candidate];
+	double vx = planes.vx(plane), vy = planes.vy(plane);
+	double z = planes.z(plane);
+	if (change.maneuver == ADVISORY_HEADING) {
+		double angle = change.change * M_PI / 180;
+		double turnedX = vx * std::cos(angle) - vy * std::sin(angle);
+		double turnedY = vx * std::sin(angle) + vy * std::cos(angle);
+		vx = turnedX;
+		vy = turnedY;
+	} else if (change.maneuver == ADVISORY_ALTITUDE) {
+		z += change.change;
+	} else {
+		vx *= 1 + change.change;
+		vy *= 1 + change.change;
+	}
+
+	command.ID = planes.id(plane);
+	command.VelocityX = vx;
+	command.VelocityY = vy;
+	command.VelocityZ = planes.vz(plane);
+	command.altitude = z;
+}
+
+// Writes the maneuvered aircraft into the spare row and tests it against the planes
+// it could reach
+void ResolutionAdvisor::check(uint32_t plane, uint32_t candidate, Scratch& own, Outcome& outcome) const {
+	msg_change_heading command;
+	maneuver(plane, candidate, command);
+	outcome.checked = true;
+	if (command.altitude < minAltitude || command.altitude > maxAltitude) {
+		// Out of the airspace: never advised
+		return;
+	}
+
+	PlaneColumns& probe = own.probe;
+	uint32_t spare = planes.size();
+	probe.x[spare] = planes.x(plane);
+	probe.y[spare] = planes.y(plane);
+	probe.z[spare] = command.altitude;
+	probe.vx[spare] = command.VelocityX;
+	probe.vy[spare] = command.VelocityY;
+	probe.vz[spare] = command.VelocityZ;
+	PlaneView view = probe.view();
+
+	const uint32_t* before = partners.data() + partnerStart[plane];
+	const uint32_t* beforeEnd = partners.data() + partnerStart[plane + 1];
+	int still = 0;
+	int introduced = 0;
+	for (size_t first = 0; first < own.nearby.size(); first += CONFLICT_BLOCK) {
+		uint32_t block = std::min<size_t>(CONFLICT_BLOCK, own.nearby.size() - first);
+		const uint32_t* others = own.nearby.data() + first;
+		uint32_t mask = conflictMask(view, spare, others, block, separation, horizon);
+		for (; mask; mask &= mask - 1) {
+			if (std::binary_search(before, beforeEnd, others[__builtin_ctz(mask)])) {
+				++still;
+			} else {
+				++introduced;
+			}
+		}
+	}
+	outcome.resolved = (beforeEnd - before) - still;
+	outcome.introduced = introduced;
+}
+
+uint32_t ResolutionAdvisor::getClusterCount() const {
+	return clusters.size();
+}
+
+uint32_t ResolutionAdvisor::getAdvisedClusterCount() const {
+	return advisedClusters;
+}
+
+size_t ResolutionAdvisor::getCandidateCount() const {
+	return checkedTrials;
+}
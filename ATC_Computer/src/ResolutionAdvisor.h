@@ -0,0 +1,131 @@
+/*
+ * Resolution advisories: for each cluster of conflicting aircraft, the
+ * heading, altitude and speed changes that clear its conflicts, best first.
+ *
+ * Conflicts that share an aircraft form a cluster, and clusters are handled
+ * most urgent first. Every aircraft of a cluster gets the candidate maneuvers
+ * of ADVISORY_MANEUVERS, and each candidate is checked against the whole
+ * frame with the conflict kernel: the maneuvered aircraft is written into a
+ * spare row after the frame and tested against the other rows. Only rows
+ * whose path crosses the box the aircraft can reach under any of the
+ * maneuvers are tested; that scan is done once per aircraft and shared by
+ * all its candidates. A candidate ranks by the conflicts it leaves (cluster
+ * conflicts it does not clear plus the ones it causes), then by how large a
+ * change it asks for. A climb or descent that would leave the airspace's
+ * altitude band is never advised: it clears conflicts only by dropping the
+ * aircraft from the picture.
+ *
+ * The aircraft of all clusters are shared out over a fixed pool of worker
+ * threads, which take them off a counter in cluster order until the list or
+ * the per-frame budget runs out. Under heavy traffic the least urgent
+ * clusters then get no advisory that frame rather than delay the next one.
+ */
+
+#ifndef RESOLUTIONADVISOR_H_
+#define RESOLUTIONADVISOR_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+#include "Msg_structs.h"
+#include "SharedAirspace.h"
+#include "ConflictDetection.h"
+#include "WorkerPool.h"
+
+// Time the advisor may take per frame, on top of the collision check
+const double ADVISORY_BUDGET_MS = 20;
+
+// Advisories kept per cluster
+const uint32_t ADVISORIES_PER_CLUSTER = 3;
+
+// A maneuver tried on every aircraft of a cluster, and what it costs the aircraft
+struct AdvisoryCandidate {
+	AdvisoryManeuver maneuver;
+	float change;
+	float cost;
+};
+
+const AdvisoryCandidate ADVISORY_MANEUVERS[] = {
+	{ADVISORY_HEADING, 15, 1},		{ADVISORY_HEADING, -15, 1},
+	{ADVISORY_ALTITUDE, 1000, 1},	{ADVISORY_ALTITUDE, -1000, 1},
+	{ADVISORY_SPEED, -0.1f, 1},		{ADVISORY_SPEED, 0.1f, 1},
+	{ADVISORY_HEADING, 30, 2},		{ADVISORY_HEADING, -30, 2},
+	{ADVISORY_ALTITUDE, 2000, 2},	{ADVISORY_ALTITUDE, -2000, 2},
+	{ADVISORY_SPEED, -0.2f, 2},		{ADVISORY_SPEED, 0.2f, 2},
+	{ADVISORY_HEADING, 45, 3},		{ADVISORY_HEADING, -45, 3},
+};
+
+class ResolutionAdvisor {
+public:
+	// Altitudes outside [minAltitude, maxAltitude] are never advised
+	ResolutionAdvisor(const Separation& separation, double minAltitude, double maxAltitude, unsigned workers = 1,
+					  double budgetMs = ADVISORY_BUDGET_MS);
+
+	// Advisories for `conflicts`, as CollisionEngine::evaluate found them in `planes`
+	// for `horizon` seconds, ordered by cluster and rank
+	void advise(const PlaneView& planes, const std::vector<msg_collision>& conflicts, double horizon,
+				std::vector<msg_advisory>& advisories);
+
+	// Clusters in the last frame, and how many of them got advisories within the budget
+	uint32_t getClusterCount() const;
+	uint32_t getAdvisedClusterCount() const;
+	// Candidates checked in the last frame
+	size_t getCandidateCount() const;
+
+private:
+	struct Cluster {
+		uint32_t firstMember;			// Its members in `members`
+		uint32_t memberCount;
+		uint32_t conflicts;
+		float urgency;					// Earliest loss of separation
+	};
+
+	// What one maneuver of one member does
+	struct Outcome {
+		bool checked;
+		int resolved;
+		int introduced;
+	};
+
+	// The probe row and shortlist of one worker
+	struct Scratch {
+		PlaneColumns probe;				// The frame plus a spare row for the maneuvered aircraft
+		std::vector<uint32_t> nearby;	// Planes the maneuvered aircraft could reach
+	};
+
+	void findClusters(const std::vector<msg_collision>& conflicts);
+	void checkMembers(unsigned index);
+	void findNearby(uint32_t plane, Scratch& scratch) const;
+	void maneuver(uint32_t plane, uint32_t candidate, msg_change_heading& command) const;
+	void check(uint32_t plane, uint32_t candidate, Scratch& scratch, Outcome& outcome) const;
+
+	Separation separation;
+	double minAltitude;
+	double maxAltitude;
+	unsigned workerCount;
+	double budgetMs;
+
+	// The frame in progress, in flat arrays reused from frame to frame
+	PlaneView planes;
+	double horizon;
+	std::chrono::steady_clock::time_point deadline;
+	std::vector<Cluster> clusters;		// Most urgent first
+	std::vector<uint32_t> members;		// Plane indices, cluster by cluster
+	std::vector<uint32_t> partnerStart;	// Conflicting planes of plane i are partners[partnerStart[i], partnerStart[i + 1])
+	std::vector<uint32_t> partners;
+	std::vector<uint32_t> parent;		// Union-find forest over plane indices
+	std::vector<uint32_t> clusterOf;	// Cluster of each union-find root
+	std::vector<Outcome> outcomes;		// Member by member, ADVISORY_MANEUVERS in order
+	std::atomic<size_t> nextMember;		// Next member to hand out
+	size_t checkedTrials;
+	uint32_t advisedClusters;
+
+	// One per worker
+	std::vector<Scratch> scratch;
+
+	// Last, so that its threads are joined before the buffers they use go away
+	WorkerPool pool;
+};
+
+#endif /* RESOLUTIONADVISOR_H_ */
@@ -0,0 +1,200 @@
+#include "SpatialGrid.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// Most slices the lookahead window is cut into
+const uint32_t MAX_TIME_SLICES = 64;
+
+namespace {
+
+size_t bucketOf(const int32_t cell[3], size_t bucketMask) {
+	uint32_t hash = static_cast<uint32_t>(cell[0]) * 73856093u
+				  ^ static_cast<uint32_t>(cell[1]) * 19349663u
+				  ^ static_cast<uint32_t>(cell[2]) * 83492791u;
+	return hash & bucketMask;
+}
+
+}
+
+SpatialGrid::SpatialGrid(double separationX, double separationY, double separationZ)
+	: separation{separationX, separationY, separationZ}, cellSize{1, 1, 1}, sliceLength(0), slices(1), strips(1),
+	  stripLow(0), stripWidth(1), candidateCount(0) {}
+
+// Box swept by plane i during [t0, t1], padded by half the separation
+void SpatialGrid::sweep(const PlaneView& planes, uint32_t i, double t0, double t1, Box& box) const {
+	for (int axis = 0; axis < 3; ++axis) {
+		double position = planes.value(static_cast<PlaneColumn>(COLUMN_X + axis), i);
+		double velocity = planes.value(static_cast<PlaneColumn>(COLUMN_VX + axis), i);
+		double start = position + velocity * t0;
+		double end = position + velocity * t1;
+		box.low[axis] = std::min(start, end) - separation[axis] / 2;
+		box.high[axis] = std::max(start, end) + separation[axis] / 2;
+	}
+}
+
+void SpatialGrid::findCandidates(const PlaneView& planes, double lookahead, std::vector<std::pair<uint32_t, uint32_t>>& pairs) {
+	prepare(planes, lookahead);
+	pairs.clear();
+	for (uint32_t unit = 0; unit < getUnitCount(); ++unit) {
+		collectUnit(planes, unit, scratch, pairs);
+	}
+
+	// A pair close during several slices is reported once per slice
+	std::sort(pairs.begin(), pairs.end());
+	pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+	candidateCount = pairs.size();
+}
+
+void SpatialGrid::prepare(const PlaneView& planes, double lookahead, uint32_t minUnits) {
+	uint32_t count = planes.size();
+	candidateCount = 0;
+
+	// Cut the window so that a plane's mean travel per slice is about two separations
+	slices = 1;
+	if (count) {
+		double travel = 0;
+		for (uint32_t i = 0; i < count; ++i) {
+			double planeTravel = 0;
+			for (int axis = 0; axis < 3; ++axis) {
+				planeTravel = std::max(planeTravel, std::abs(planes.value(static_cast<PlaneColumn>(COLUMN_VX + axis), i))
+					* lookahead / std::max(separation[axis], 1.0));
+			}
+			travel += planeTravel;
+		}
+		slices = std::min<uint32_t>(MAX_TIME_SLICES, std::max(1.0, std::ceil(travel / count / 2)));
+	}
+	sliceLength = lookahead / slices;
+
+	// Cells are a separation wide, or the mean box if that is larger. A box spans
+	// |v| * sliceLength plus the separation on each axis.
+	double speed[3] = {0, 0, 0};
+	double xLow = std::numeric_limits<double>::infinity();
+	double xHigh = -xLow;
+	for (uint32_t i = 0; i < count; ++i) {
+		for (int axis = 0; axis < 3; ++axis) {
+			speed[axis] += std::abs(planes.value(static_cast<PlaneColumn>(COLUMN_VX + axis), i));
+		}
+		double start = planes.x(i);
+		double end = start + planes.vx(i) * lookahead;
+		xLow = std::min(xLow, std::min(start, end));
+		xHigh = std::max(xHigh, std::max(start, end));
+	}
+	for (int axis = 0; axis < 3; ++axis) {
+		cellSize[axis] = std::max(separation[axis], 1.0);
+		if (count) {
+			cellSize[axis] = std::max(cellSize[axis], speed[axis] / count * sliceLength + separation[axis]);
+		}
+	}
+
+	// Split each slice into strips of x cells when more units are wanted than there are slices
+	strips = 1;
+	stripLow = 0;
+	stripWidth = 1;
+	if (count && minUnits > slices) {
+		int32_t low = static_cast<int32_t>(std::floor((xLow - separation[0] / 2) / cellSize[0]));
+		int32_t high = static_cast<int32_t>(std::floor((xHigh + separation[0] / 2) / cellSize[0]));
+		uint32_t span = static_cast<uint32_t>(high - low) + 1;
+		strips = std::min(span, (minUnits + slices - 1) / slices);
+		stripLow = low;
+		stripWidth = static_cast<int32_t>((span + strips - 1) / strips);
+	}
+}
+
+uint32_t SpatialGrid::getUnitCount() const {
+	return slices * strips;
+}
+
+void SpatialGrid::collectUnit(const PlaneView& planes, uint32_t unit, Scratch& scratch,
+							  std::vector<std::pair<uint32_t, uint32_t>>& pairs) const {
+	uint32_t count = planes.size();
+	uint32_t slice = unit / strips;
+	uint32_t strip = unit % strips;
+
+	// The outer strips are open-ended, so every x cell belongs to exactly one strip
+	int32_t firstCell = strip == 0 ? std::numeric_limits<int32_t>::min() : stripLow + static_cast<int32_t>(strip) * stripWidth;
+	int32_t lastCell = strip + 1 == strips ? std::numeric_limits<int32_t>::max()
+										   : stripLow + static_cast<int32_t>(strip + 1) * stripWidth - 1;
+
+	// Boxes for this slice, and an entry for every cell of the strip they cover
+	std::vector<Box>& boxes = scratch.boxes;
+	std::vector<Entry>& entries = scratch.entries;
+	boxes.resize(count);
+	entries.clear();
+	for (uint32_t i = 0; i < count; ++i) {
+		Box& box = boxes[i];
+		sweep(planes, i, slice * sliceLength, (slice + 1) * sliceLength, box);
+		for (int axis = 0; axis < 3; ++axis) {
+			box.cellLow[axis] = static_cast<int32_t>(std::floor(box.low[axis] / cellSize[axis]));
+			box.cellHigh[axis] = static_cast<int32_t>(std::floor(box.high[axis] / cellSize[axis]));
+		}
+		Entry entry;
+		entry.plane = i;
+		int32_t xLast = std::min(box.cellHigh[0], lastCell);
+		for (entry.cell[0] = std::max(box.cellLow[0], firstCell); entry.cell[0] <= xLast; ++entry.cell[0]) {
+			for (entry.cell[1] = box.cellLow[1]; entry.cell[1] <= box.cellHigh[1]; ++entry.cell[1]) {
+				for (entry.cell[2] = box.cellLow[2]; entry.cell[2] <= box.cellHigh[2]; ++entry.cell[2]) {
+					entries.push_back(entry);
+				}
+			}
+		}
+	}
+
+	// Counting sort of the entries into power-of-two hash buckets
+	size_t buckets = 64;
+	while (buckets < 2 * entries.size()) {
+		buckets *= 2;
+	}
+	size_t bucketMask = buckets - 1;
+	std::vector<uint32_t>& bucketStart = scratch.bucketStart;
+	std::vector<Entry>& sorted = scratch.sorted;
+	bucketStart.assign(buckets + 1, 0);
+	for (const Entry& entry : entries) {
+		bucketStart[bucketOf(entry.cell, bucketMask) + 1]++;
+	}
+	for (size_t b = 0; b < buckets; ++b) {
+		bucketStart[b + 1] += bucketStart[b];
+	}
+	scratch.bucketFill.assign(bucketStart.begin(), bucketStart.end() - 1);
+	sorted.resize(entries.size());
+	for (const Entry& entry : entries) {
+		sorted[scratch.bucketFill[bucketOf(entry.cell, bucketMask)]++] = entry;
+	}
+
+	for (size_t b = 0; b < buckets; ++b) {
+		for (uint32_t first = bucketStart[b]; first < bucketStart[b + 1]; ++first) {
+			const Entry& e1 = sorted[first];
+			for (uint32_t second = first + 1; second < bucketStart[b + 1]; ++second) {
+				const Entry& e2 = sorted[second];
+				// Different cells can share a bucket
+				if (e1.cell[0] != e2.cell[0] || e1.cell[1] != e2.cell[1] || e1.cell[2] != e2.cell[2]) {
+					continue;
+				}
+
+				const Box& a = boxes[e1.plane];
+				const Box& c = boxes[e2.plane];
+				bool overlap = true;
+				bool lowCorner = true;
+				for (int axis = 0; axis < 3; ++axis) {
+					overlap = overlap && a.low[axis] <= c.high[axis] && c.low[axis] <= a.high[axis];
+					lowCorner = lowCorner && e1.cell[axis] == std::max(a.cellLow[axis], c.cellLow[axis]);
+				}
+				if (overlap && lowCorner) {
+					pairs.emplace_back(std::min(e1.plane, e2.plane), std::max(e1.plane, e2.plane));
+				}
+			}
+		}
+	}
+}
+
+void SpatialGrid::setCandidateCount(size_t count) {
+	candidateCount = count;
+}
+
+uint32_t SpatialGrid::getTimeSlices() const {
+	return slices;
+}
+
+size_t SpatialGrid::getCandidateCount() const {
+	return candidateCount;
+}
@@ -0,0 +1,95 @@
+/*
+ * Broad phase for the collision check: a uniform grid over space and time,
+ * stored as a spatial hash.
+ *
+ * The lookahead window is cut into time slices, and each aircraft is binned
+ * by the box it sweeps during every slice, padded by half the separation on
+ * every axis. Two aircraft can only come within the separation at some time
+ * in the window if their boxes for that time's slice overlap, so only
+ * aircraft sharing a (slice, cell) are handed to the narrow phase. Without
+ * the slices a long lookahead stretches every box across most of the
+ * airspace and the grid stops pruning anything.
+ *
+ * The slice count follows the mean travel per window, and cells are at
+ * least one separation wide (or the mean box size if larger), so every box
+ * covers a handful of cells. A pair sharing several cells in a slice is only
+ * reported from the cell at the low corner of the overlap of their cell
+ * ranges; pairs seen in several slices are merged at the end.
+ *
+ * Slices share nothing, so the grid is built and searched one unit at a
+ * time: a slice, or a strip of cells along x of a slice when more units are
+ * asked for than there are slices. Each unit hashes only its own cells into
+ * caller-provided scratch buffers, which lets threads take units in parallel.
+ *
+ * All buffers are kept between frames and only grow.
+ */
+
+#ifndef SPATIALGRID_H_
+#define SPATIALGRID_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "SharedAirspace.h"
+
+class SpatialGrid {
+private:
+	struct Box {
+		double low[3];
+		double high[3];
+		int32_t cellLow[3];
+		int32_t cellHigh[3];
+	};
+
+	struct Entry {
+		int32_t cell[3];
+		uint32_t plane;
+	};
+
+public:
+	// Buffers for collecting one unit at a time
+	struct Scratch {
+		std::vector<Box> boxes;				// One per plane, for the unit's slice
+		std::vector<Entry> entries;			// One per (plane, covered cell of the unit)
+		std::vector<Entry> sorted;			// Entries grouped by bucket
+		std::vector<uint32_t> bucketStart;	// Offset of each bucket in `sorted`, plus an end marker
+		std::vector<uint32_t> bucketFill;	// Next free slot of each bucket while sorting
+	};
+
+	SpatialGrid(double separationX, double separationY, double separationZ);
+
+	// Candidate pairs (i, j), i < j, of indices into `planes` that may come within the
+	// separation during [0, lookahead] seconds, sorted
+	void findCandidates(const PlaneView& planes, double lookahead, std::vector<std::pair<uint32_t, uint32_t>>& pairs);
+
+	// findCandidates in steps: size the grid for at least `minUnits` units, then append the
+	// pairs of each unit. Units may report the same pair (from different slices) and in no
+	// particular order. collectUnit does not modify the grid, so units can be collected
+	// concurrently as long as each thread has its own scratch.
+	void prepare(const PlaneView& planes, double lookahead, uint32_t minUnits = 1);
+	uint32_t getUnitCount() const;
+	void collectUnit(const PlaneView& planes, uint32_t unit, Scratch& scratch,
+					 std::vector<std::pair<uint32_t, uint32_t>>& pairs) const;
+	// Record the merged candidate count when the pairs were collected in steps
+	void setCandidateCount(size_t count);
+
+	// Figures from the last search
+	uint32_t getTimeSlices() const;
+	size_t getCandidateCount() const;
+
+private:
+	void sweep(const PlaneView& planes, uint32_t i, double t0, double t1, Box& box) const;
+
+	double separation[3];
+	double cellSize[3];
+	double sliceLength;
+	uint32_t slices;
+	uint32_t strips;			// Units per slice
+	int32_t stripLow;			// First x cell of the strips
+	int32_t stripWidth;			// x cells per strip
+	size_t candidateCount;
+	Scratch scratch;			// For findCandidates
+};
+
+#endif /* SPATIALGRID_H_ */
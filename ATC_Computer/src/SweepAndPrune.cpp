@@ -0,0 +1,217 @@
+#include "SweepAndPrune.h"
+#include <algorithm>
+
+SweepAndPrune::SweepAndPrune(double separationX, double separationY, double separationZ)
+	: separation{separationX, separationY, separationZ}, swapCount(0), rebuilt(false) {}
+
+// Sort order of the points on an axis; a begin point goes before an end point at the
+// same value, so boxes that only touch count as overlapping
+bool SweepAndPrune::before(const Endpoint& a, const Endpoint& b) {
+	return a.value < b.value || (a.value == b.value && !a.end && b.end);
+}
+
+uint64_t SweepAndPrune::pairKey(uint32_t a, uint32_t b) {
+	return (static_cast<uint64_t>(std::min(a, b)) << 32) | std::max(a, b);
+}
+
+bool SweepAndPrune::overlaps(uint32_t a, uint32_t b) const {
+	const Box& first = boxes[a];
+	const Box& second = boxes[b];
+	for (int axis = 0; axis < 3; ++axis) {
+		if (first.low[axis] > second.high[axis] || second.low[axis] > first.high[axis]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void SweepAndPrune::update(const PlaneView& planes, double lookahead) {
+	swapCount = 0;
+	rebuilt = false;
+	added.clear();
+	removed.clear();
+	for (Box& box : boxes) {
+		box.seen = false;
+		box.fresh = false;
+	}
+
+	// Boxes of this frame, keyed by aircraft id
+	for (uint32_t i = 0; i < planes.size(); ++i) {
+		int id = planes.id(i);
+		auto found = boxOf.find(id);
+		uint32_t slot;
+		if (found != boxOf.end()) {
+			slot = found->second;
+		} else {
+			if (!freeBoxes.empty()) {
+				slot = freeBoxes.back();
+				freeBoxes.pop_back();
+			} else {
+				slot = boxes.size();
+				boxes.emplace_back();
+			}
+			boxOf[id] = slot;
+			boxes[slot].id = id;
+			boxes[slot].live = true;
+			boxes[slot].fresh = true;
+			added.push_back(slot);
+		}
+
+		Box& box = boxes[slot];
+		box.index = i;
+		box.seen = true;
+		for (int axis = 0; axis < 3; ++axis) {
+			double start = planes.value(static_cast<PlaneColumn>(COLUMN_X + axis), i);
+			double end = start + planes.value(static_cast<PlaneColumn>(COLUMN_VX + axis), i) * lookahead;
+			box.low[axis] = std::min(start, end) - separation[axis] / 2;
+			box.high[axis] = std::max(start, end) + separation[axis] / 2;
+		}
+	}
+	for (uint32_t slot = 0; slot < boxes.size(); ++slot) {
+		Box& box = boxes[slot];
+		if (box.live && !box.seen) {
+			box.live = false;
+			boxOf.erase(box.id);
+			freeBoxes.push_back(slot);
+			removed.push_back(slot);
+		}
+	}
+
+	// A large wave of changes costs more to merge in than to sort from scratch
+	if (axes[0].empty() || (added.size() + removed.size()) * 4 > planes.size()) {
+		rebuild();
+		return;
+	}
+
+	// Drop the points and pairs of aircraft that left
+	if (!removed.empty()) {
+		for (int axis = 0; axis < 3; ++axis) {
+			std::vector<Endpoint>& list = axes[axis];
+			list.erase(std::remove_if(list.begin(), list.end(), [this](const Endpoint& e) { return !boxes[e.box].live; }),
+					   list.end());
+		}
+		for (auto it = overlapping.begin(); it != overlapping.end();) {
+			bool gone = !boxes[*it >> 32].live || !boxes[*it & 0xffffffffu].live;
+			it = gone ? overlapping.erase(it) : std::next(it);
+		}
+	}
+
+	// Aircraft still here have only moved a little: insertion sort fixes the order
+	for (int axis = 0; axis < 3; ++axis) {
+		for (Endpoint& e : axes[axis]) {
+			e.value = e.end ? boxes[e.box].high[axis] : boxes[e.box].low[axis];
+		}
+		sortAxis(axis);
+	}
+
+	// New aircraft are merged in sorted, then paired in one sweep along x
+	if (!added.empty()) {
+		for (int axis = 0; axis < 3; ++axis) {
+			std::vector<Endpoint>& list = axes[axis];
+			size_t middle = list.size();
+			for (uint32_t slot : added) {
+				list.push_back(Endpoint{boxes[slot].low[axis], slot, false});
+				list.push_back(Endpoint{boxes[slot].high[axis], slot, true});
+			}
+			std::sort(list.begin() + middle, list.end(), before);
+			std::inplace_merge(list.begin(), list.begin() + middle, list.end(), before);
+		}
+		sweepPairs(true);
+	}
+}
+
+// Insertion sort of one axis. Moving a point past another flips the overlap of their
+// two boxes on this axis when one is a begin point and the other an end point.
+void SweepAndPrune::sortAxis(int axis) {
+	std::vector<Endpoint>& list = axes[axis];
+	for (size_t k = 1; k < list.size(); ++k) {
+		Endpoint e = list[k];
+		size_t j = k;
+		while (j > 0 && before(e, list[j - 1])) {
+			const Endpoint& previous = list[j - 1];
+			if (!e.end && previous.end) {
+				// e's box now begins before the other ends: check the other axes
+				if (overlaps(e.box, previous.box)) {
+					overlapping.insert(pairKey(e.box, previous.box));
+				}
+			} else if (e.end && !previous.end) {
+				// e's box now ends before the other begins
+				overlapping.erase(pairKey(e.box, previous.box));
+			}
+			list[j] = previous;
+			--j;
+			++swapCount;
+		}
+		list[j] = e;
+	}
+}
+
+void SweepAndPrune::rebuild() {
+	rebuilt = true;
+	overlapping.clear();
+	for (int axis = 0; axis < 3; ++axis) {
+		std::vector<Endpoint>& list = axes[axis];
+		list.clear();
+		for (uint32_t slot = 0; slot < boxes.size(); ++slot) {
+			if (boxes[slot].live) {
+				list.push_back(Endpoint{boxes[slot].low[axis], slot, false});
+				list.push_back(Endpoint{boxes[slot].high[axis], slot, true});
+			}
+		}
+		std::sort(list.begin(), list.end(), before);
+	}
+
+	sweepPairs(false);
+}
+
+// Sweep along x: a box overlaps on x every box still open where it begins. With
+// `freshOnly`, only pairs with at least one box that entered this update are
+// looked for, so a box kept from the last update is only tested against the
+// fresh boxes open at its begin point.
+void SweepAndPrune::sweepPairs(bool freshOnly) {
+	std::vector<uint32_t> open[2];	// Kept boxes, fresh boxes (every box without freshOnly)
+	std::vector<size_t> openAt(boxes.size());
+	for (const Endpoint& e : axes[0]) {
+		bool fresh = !freshOnly || boxes[e.box].fresh;
+		std::vector<uint32_t>& own = open[fresh];
+		if (!e.end) {
+			for (int list = fresh ? 0 : 1; list < 2; ++list) {
+				for (uint32_t other : open[list]) {
+					if (overlaps(e.box, other)) {
+						overlapping.insert(pairKey(e.box, other));
+					}
+				}
+			}
+			openAt[e.box] = own.size();
+			own.push_back(e.box);
+		} else {
+			size_t at = openAt[e.box];
+			own[at] = own.back();
+			openAt[own[at]] = at;
+			own.pop_back();
+		}
+	}
+}
+
+void SweepAndPrune::getCandidates(std::vector<std::pair<uint32_t, uint32_t>>& pairs) const {
+	pairs.clear();
+	pairs.reserve(overlapping.size());
+	for (uint64_t key : overlapping) {
+		uint32_t first = boxes[key >> 32].index;
+		uint32_t second = boxes[key & 0xffffffffu].index;
+		pairs.emplace_back(std::min(first, second), std::max(first, second));
+	}
+	std::sort(pairs.begin(), pairs.end());
+}
+
+size_t SweepAndPrune::getOverlapCount() const {
+	return overlapping.size();
+}
+
+size_t SweepAndPrune::getSwapCount() const {
+	return swapCount;
+}
+
+bool SweepAndPrune::wasRebuilt() const {
+	return rebuilt;
+}
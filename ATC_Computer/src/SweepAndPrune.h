@@ -0,0 +1,86 @@
+/*
+ * Incremental broad phase for the collision check: sweep and prune over the
+ * box each aircraft sweeps during the lookahead window, padded by half the
+ * separation on every axis, kept from one evaluation to the next.
+ *
+ * Every axis holds the begin and end points of all boxes in sorted order.
+ * Between two frames the boxes only slide a little, so the lists are brought
+ * back in order by insertion sort with few swaps. Two boxes start or stop
+ * overlapping on an axis exactly when a begin point of one swaps with an end
+ * point of the other, and those swaps are where the set of pairs overlapping
+ * on all three axes is updated. A frame costs O(n + swaps) instead of
+ * rebuilding the structure.
+ *
+ * Boxes are keyed by aircraft id. Aircraft that enter are merged into the
+ * lists, and one sweep along x then pairs them with the boxes they overlap,
+ * so entries cost O(n + their overlaps) rather than a test against every box;
+ * aircraft that leave have their points and pairs dropped. When much of the
+ * frame changed at once (the first frame, a large wave of entries) the lists
+ * are sorted from scratch and all pairs found with the same sweep instead.
+ */
+
+#ifndef SWEEPANDPRUNE_H_
+#define SWEEPANDPRUNE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include "SharedAirspace.h"
+
+class SweepAndPrune {
+public:
+	SweepAndPrune(double separationX, double separationY, double separationZ);
+
+	// Bring the boxes up to date with `planes` over [0, lookahead] seconds: new
+	// aircraft are added, aircraft missing from `planes` removed
+	void update(const PlaneView& planes, double lookahead);
+
+	// Pairs (i, j), i < j, of indices into the planes of the last update whose boxes
+	// overlap, sorted
+	void getCandidates(std::vector<std::pair<uint32_t, uint32_t>>& pairs) const;
+
+	// Figures from the last update
+	size_t getOverlapCount() const;
+	size_t getSwapCount() const;
+	bool wasRebuilt() const;
+
+private:
+	struct Box {
+		int id;
+		uint32_t index;		// Position in the planes of the last update
+		bool live;
+		bool seen;
+		bool fresh;			// Entered in the last update
+		double low[3];
+		double high[3];
+	};
+
+	struct Endpoint {
+		double value;
+		uint32_t box;
+		bool end;
+	};
+
+	static bool before(const Endpoint& a, const Endpoint& b);
+	static uint64_t pairKey(uint32_t a, uint32_t b);
+	bool overlaps(uint32_t a, uint32_t b) const;
+	void sortAxis(int axis);
+	void sweepPairs(bool freshOnly);
+	void rebuild();
+
+	double separation[3];
+	std::vector<Box> boxes;
+	std::vector<uint32_t> freeBoxes;			// Slots of aircraft that left, for reuse
+	std::unordered_map<int, uint32_t> boxOf;	// Aircraft id to box slot
+	std::vector<Endpoint> axes[3];
+	std::unordered_set<uint64_t> overlapping;	// Box slot pairs overlapping on every axis
+	std::vector<uint32_t> added;
+	std::vector<uint32_t> removed;
+	size_t swapCount;
+	bool rebuilt;
+};
+
+#endif /* SWEEPANDPRUNE_H_ */
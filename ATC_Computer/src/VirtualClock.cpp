@@ -0,0 +1,378 @@
+#include "VirtualClock.h"
+#include <iostream>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <signal.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+uint64_t monotonicNs() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return static_cast<uint64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+}
+
+// RAII lock on the segment mutex. A process that died holding it is dropped
+// from the counts by the owner, so the lock is simply made consistent again.
+class SegmentLock {
+public:
+	explicit SegmentLock(ClockSegment* segment) : segment(segment) { recover(pthread_mutex_lock(&segment->mutex)); }
+	~SegmentLock() { pthread_mutex_unlock(&segment->mutex); }
+	void wait() { recover(pthread_cond_wait(&segment->changed, &segment->mutex)); }
+	// False once `ms` have passed without a broadcast
+	bool waitFor(uint32_t ms) {
+		uint64_t due = monotonicNs() + static_cast<uint64_t>(ms) * 1000000;
+		struct timespec deadline;
+		deadline.tv_sec = due / 1000000000;
+		deadline.tv_nsec = due % 1000000000;
+		int result = pthread_cond_timedwait(&segment->changed, &segment->mutex, &deadline);
+		recover(result);
+		return result != ETIMEDOUT;
+	}
+
+private:
+	void recover(int result) {
+		if (result == EOWNERDEAD) {
+			pthread_mutex_consistent(&segment->mutex);
+		}
+	}
+
+	ClockSegment* segment;
+};
+
+// This process's entry in the process table, claimed if it has none yet. Called with the lock held.
+ClockProcess* processEntry(ClockSegment* segment) {
+	pid_t pid = getpid();
+	ClockProcess* unused = nullptr;
+	for (ClockProcess& process : segment->processes) {
+		if (process.pid == pid) {
+			return &process;
+		}
+		if (process.pid == 0 && !unused) {
+			unused = &process;
+		}
+	}
+	if (!unused) {
+		std::cerr << "Virtual clock: process table full; participants of process " << pid
+				  << " cannot be dropped if it dies" << std::endl;
+		return nullptr;
+	}
+	std::memset(unused, 0, sizeof(ClockProcess));
+	unused->pid = pid;
+	return unused;
+}
+
+// Frees the entry once the process has no participants left. Called with the lock held.
+void releaseIfIdle(ClockProcess* process) {
+	for (int stage = 0; stage < CLOCK_STAGE_COUNT; ++stage) {
+		if (process->participants[stage] || process->deferred[stage]) {
+			return;
+		}
+	}
+	process->pid = 0;
+}
+
+}
+
+VirtualClock::VirtualClock() : shm_fd(-1), segment(nullptr), owner(false), startNs(0) {}
+
+VirtualClock::~VirtualClock() {
+	close();
+}
+
+bool VirtualClock::create(ClockMode mode, uint32_t stepMs, double speed) {
+	shm_fd = shm_open(CLOCK_SHM_NAME, O_CREAT | O_RDWR, 0666);
+	if (shm_fd == -1) {
+		std::cerr << "Failed to open clock shared memory" << std::endl;
+		return false;
+	}
+	if (ftruncate(shm_fd, sizeof(ClockSegment)) == -1) {
+		std::cerr << "Failed to set clock shared memory size" << std::endl;
+		close();
+		return false;
+	}
+	void* mapping = mmap(NULL, sizeof(ClockSegment), PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
+	if (mapping == MAP_FAILED) {
+		std::cerr << "Failed to map clock shared memory" << std::endl;
+		close();
+		return false;
+	}
+	segment = static_cast<ClockSegment*>(mapping);
+	owner = true;
+
+	// Others only open a segment with the current version, so hide it until it is set up
+	segment->layout_version = 0;
+	std::atomic_thread_fence(std::memory_order_release);
+
+	pthread_mutexattr_t mutexAttr;
+	pthread_mutexattr_init(&mutexAttr);
+	pthread_mutexattr_setpshared(&mutexAttr, PTHREAD_PROCESS_SHARED);
+	pthread_mutexattr_setrobust(&mutexAttr, PTHREAD_MUTEX_ROBUST);
+	pthread_mutex_init(&segment->mutex, &mutexAttr);
+	pthread_mutexattr_destroy(&mutexAttr);
+
+	pthread_condattr_t condAttr;
+	pthread_condattr_init(&condAttr);
+	pthread_condattr_setpshared(&condAttr, PTHREAD_PROCESS_SHARED);
+	pthread_condattr_setclock(&condAttr, CLOCK_MONOTONIC);
+	pthread_cond_init(&segment->changed, &condAttr);
+	pthread_condattr_destroy(&condAttr);
+
+	segment->mode = mode;
+	segment->step_ms = std::max(stepMs, 1u);
+	segment->speed = speed > 0 ? speed : 1;
+	segment->now_ms.store(0, std::memory_order_relaxed);
+	segment->tick = 0;
+	segment->turn = CLOCK_STAGE_COUNT;	// Tick 0 is complete; everyone joins for tick 1
+	segment->stopped = false;
+	for (int stage = 0; stage < CLOCK_STAGE_COUNT; ++stage) {
+		segment->participants[stage] = 0;
+		segment->completed[stage] = 0;
+		segment->deferred[stage] = 0;
+	}
+	std::memset(segment->processes, 0, sizeof(segment->processes));
+
+	std::atomic_thread_fence(std::memory_order_release);
+	segment->layout_version = CLOCK_LAYOUT_VERSION;
+	return true;
+}
+
+bool VirtualClock::open() {
+	shm_fd = shm_open(CLOCK_SHM_NAME, O_RDWR, 0666);
+	if (shm_fd == -1) {
+		return false;
+	}
+
+	// Never map past the end of the file; that would fault on access
+	struct stat shm_stat;
+	if (fstat(shm_fd, &shm_stat) == -1 || (size_t)shm_stat.st_size < sizeof(ClockSegment)) {
+		close();
+		return false;
+	}
+	void* mapping = mmap(NULL, sizeof(ClockSegment), PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
+	if (mapping == MAP_FAILED) {
+		close();
+		return false;
+	}
+	segment = static_cast<ClockSegment*>(mapping);
+
+	std::atomic_thread_fence(std::memory_order_acquire);
+	if (segment->layout_version != CLOCK_LAYOUT_VERSION) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+void VirtualClock::close() {
+	if (segment) {
+		if (owner) {
+			stop();
+		}
+		munmap(segment, sizeof(ClockSegment));
+		segment = nullptr;
+	}
+	if (shm_fd != -1) {
+		::close(shm_fd);
+		shm_fd = -1;
+	}
+	if (owner) {
+		shm_unlink(CLOCK_SHM_NAME);
+		owner = false;
+	}
+}
+
+bool VirtualClock::isOpen() const {
+	return segment != nullptr;
+}
+
+void VirtualClock::startTick() {
+	if (segment->mode == CLOCK_MODE_SCALED) {
+		// Tick n is due (n - 1) steps of scaled wall time after tick 1
+		uint64_t now = monotonicNs();
+		if (segment->tick == 0) {
+			startNs = now;
+		}
+		uint64_t due = startNs + static_cast<uint64_t>(segment->tick * segment->step_ms * 1e6 / segment->speed);
+		if (due > now) {
+			struct timespec wait;
+			wait.tv_sec = (due - now) / 1000000000;
+			wait.tv_nsec = (due - now) % 1000000000;
+			nanosleep(&wait, NULL);
+		}
+	}
+
+	SegmentLock lock(segment);
+	segment->tick++;
+	for (int stage = 0; stage < CLOCK_STAGE_COUNT; ++stage) {
+		segment->participants[stage] += segment->deferred[stage];
+		segment->deferred[stage] = 0;
+		segment->completed[stage] = 0;
+	}
+	for (ClockProcess& process : segment->processes) {
+		for (int stage = 0; stage < CLOCK_STAGE_COUNT; ++stage) {
+			process.participants[stage] += process.deferred[stage];
+			process.deferred[stage] = 0;
+			process.completed[stage] = 0;
+		}
+	}
+	segment->now_ms.store(segment->tick * segment->step_ms, std::memory_order_release);
+	segment->turn = 0;
+	advanceTurn();
+	pthread_cond_broadcast(&segment->changed);
+}
+
+void VirtualClock::waitTickDone() {
+	SegmentLock lock(segment);
+	while (!segment->stopped && segment->turn < CLOCK_STAGE_COUNT) {
+		if (!lock.waitFor(CLOCK_LIVENESS_CHECK_MS)) {
+			dropDeadProcesses();
+		}
+	}
+}
+
+// Takes the participants of processes that exited without leaving (killed, or
+// crashed) out of the counts, so the tick can complete. Called with the lock held.
+void VirtualClock::dropDeadProcesses() {
+	bool dropped = false;
+	for (ClockProcess& process : segment->processes) {
+		if (process.pid == 0 || kill(process.pid, 0) == 0 || errno != ESRCH) {
+			continue;
+		}
+		std::cerr << "Virtual clock: process " << process.pid << " exited without leaving; dropping its participants" << std::endl;
+		for (int stage = 0; stage < CLOCK_STAGE_COUNT; ++stage) {
+			segment->participants[stage] -= process.participants[stage];
+			segment->completed[stage] -= process.completed[stage];
+			segment->deferred[stage] -= process.deferred[stage];
+		}
+		std::memset(&process, 0, sizeof(ClockProcess));
+		dropped = true;
+	}
+	if (dropped) {
+		advanceTurn();
+		pthread_cond_broadcast(&segment->changed);
+	}
+}
+
+void VirtualClock::stop() {
+	SegmentLock lock(segment);
+	segment->stopped = true;
+	pthread_cond_broadcast(&segment->changed);
+}
+
+void VirtualClock::waitForStage(ClockStage stage) {
+	SegmentLock lock(segment);
+	while (!segment->stopped && segment->participants[stage] + segment->deferred[stage] == 0) {
+		lock.wait();
+	}
+}
+
+// Passes the turn over every stage whose participants are all done. Called with the lock held.
+void VirtualClock::advanceTurn() {
+	while (segment->turn < CLOCK_STAGE_COUNT && segment->completed[segment->turn] == segment->participants[segment->turn]) {
+		segment->turn++;
+	}
+}
+
+uint64_t VirtualClock::getTick() const {
+	SegmentLock lock(segment);
+	return segment->tick;
+}
+
+uint64_t VirtualClock::now() const {
+	return segment->now_ms.load(std::memory_order_acquire);
+}
+
+uint32_t VirtualClock::getStepMs() const {
+	return segment->step_ms;
+}
+
+ClockMode VirtualClock::getMode() const {
+	return static_cast<ClockMode>(segment->mode);
+}
+
+
+ClockParticipant::ClockParticipant(VirtualClock& virtualClock, ClockStage clockStage) : clock(virtualClock), stage(clockStage) {
+	ClockSegment* segment = clock.segment;
+	SegmentLock lock(segment);
+	process = processEntry(segment);
+	if (segment->turn <= stage) {
+		segment->participants[stage]++;
+		if (process) {
+			process->participants[stage]++;
+		}
+		firstTick = segment->tick;
+	} else {
+		segment->deferred[stage]++;
+		if (process) {
+			process->deferred[stage]++;
+		}
+		firstTick = segment->tick + 1;
+	}
+	nextTick = firstTick;
+	// Waiters use the join to notice a stage they wait for
+	pthread_cond_broadcast(&segment->changed);
+}
+
+ClockParticipant::~ClockParticipant() {
+	ClockSegment* segment = clock.segment;
+	SegmentLock lock(segment);
+	if (segment->tick < firstTick) {
+		segment->deferred[stage]--;
+		if (process) {
+			process->deferred[stage]--;
+			releaseIfIdle(process);
+		}
+		return;
+	}
+	segment->participants[stage]--;
+	if (process) {
+		process->participants[stage]--;
+	}
+	if (nextTick > segment->tick) {
+		segment->completed[stage]--;
+		if (process) {
+			process->completed[stage]--;
+		}
+	} else {
+		// Leaving mid-turn completes it for us
+		clock.advanceTurn();
+		pthread_cond_broadcast(&segment->changed);
+	}
+	if (process) {
+		releaseIfIdle(process);
+	}
+}
+
+bool ClockParticipant::waitTurn() {
+	ClockSegment* segment = clock.segment;
+	SegmentLock lock(segment);
+	while (!segment->stopped && !(segment->tick == nextTick && segment->turn == stage)) {
+		lock.wait();
+	}
+	return !segment->stopped;
+}
+
+void ClockParticipant::complete() {
+	ClockSegment* segment = clock.segment;
+	SegmentLock lock(segment);
+	segment->completed[stage]++;
+	if (process) {
+		process->completed[stage]++;
+	}
+	nextTick = segment->tick + 1;
+	clock.advanceTurn();
+	if (segment->turn != stage) {
+		pthread_cond_broadcast(&segment->changed);
+	}
+}
+
+uint64_t ClockParticipant::now() const {
+	return clock.now();
+}
@@ -0,0 +1,166 @@
+/*
+ * Virtual simulation clock shared by the aircraft, the Radar, the
+ * ComputerSystem and the Display, for running traffic faster than real time.
+ *
+ * In real time (the default) every stage keeps its own ATCTimer. With the
+ * virtual clock the simulation process creates a small shared memory segment
+ * holding the current tick; virtual time is tick * step_ms. Each tick runs
+ * the stages in order: aircraft, Radar, ComputerSystem, Display. A stage
+ * takes its turn once every participant of the stages before it has
+ * completed the tick, and the next tick only starts once all of them have.
+ * The Radar therefore always sweeps positions the aircraft have finished
+ * moving, and the ComputerSystem and Display see the frame of that same tick.
+ *
+ * The clock either runs at a fixed multiple of real time (CLOCK_MODE_SCALED: a
+ * tick never starts before its wall time, but still waits for slow stages) or
+ * as fast as the stages allow (CLOCK_MODE_LOCKSTEP), which measures compute
+ * throughput directly.
+ *
+ * A stage can have any number of participants, one per aircraft thread for
+ * instance. A participant that joins before its stage's turn has passed takes
+ * part in the current tick, otherwise from the next one. Everything in the
+ * segment is guarded by one process-shared mutex, with a condition variable
+ * broadcast whenever the tick or turn moves.
+ *
+ * A ComputerSystem or Display can be killed without leaving its stage. The
+ * segment therefore also keeps every participant's counts per process, and an
+ * owner whose tick is not done within CLOCK_LIVENESS_CHECK_MS drops the counts
+ * of processes that no longer exist. The mutex is robust, so a process that
+ * dies while holding it does not stop the others either.
+ */
+
+#ifndef VIRTUALCLOCK_H_
+#define VIRTUALCLOCK_H_
+
+#include <atomic>
+#include <cstdint>
+#include <pthread.h>
+#include <sys/types.h>
+
+// Shared memory name (same in every process)
+#define CLOCK_SHM_NAME "/tmp/AH_40247851_40228573_Clock_shm"
+
+// Bump whenever ClockSegment changes
+const uint32_t CLOCK_LAYOUT_VERSION = 2;
+
+// Processes with participants the segment can keep track of at once
+const uint32_t CLOCK_MAX_PROCESSES = 16;
+
+// How long the owner waits for a tick before it looks for participants whose process has exited
+const uint32_t CLOCK_LIVENESS_CHECK_MS = 1000;
+
+enum ClockMode {
+	CLOCK_MODE_REALTIME,		// Every stage on its own timer; no segment
+	CLOCK_MODE_SCALED,		// Virtual time at `speed` times real time
+	CLOCK_MODE_LOCKSTEP		// Next tick as soon as every stage has finished this one
+};
+
+// In the order they take their turn within a tick
+enum ClockStage {
+	CLOCK_STAGE_AIRCRAFT,
+	CLOCK_STAGE_RADAR,
+	CLOCK_STAGE_COMPUTER,
+	CLOCK_STAGE_DISPLAY,
+	CLOCK_STAGE_COUNT
+};
+
+// One process's share of the participant counts, so they can be dropped if it dies
+struct ClockProcess {
+	pid_t pid;								// 0: free entry
+	uint32_t participants[CLOCK_STAGE_COUNT];
+	uint32_t completed[CLOCK_STAGE_COUNT];
+	uint32_t deferred[CLOCK_STAGE_COUNT];
+};
+
+struct ClockSegment {
+	uint32_t layout_version;		// CLOCK_LAYOUT_VERSION once the owner has set the segment up
+	uint32_t mode;					// ClockMode
+	uint32_t step_ms;				// Virtual time per tick
+	double speed;					// Virtual over real time in CLOCK_MODE_SCALED
+	std::atomic<uint64_t> now_ms;	// Virtual time of the current tick, readable without the lock
+
+	// Guarded by mutex
+	uint64_t tick;
+	uint32_t turn;					// Stage whose turn it is; CLOCK_STAGE_COUNT once the tick is complete
+	bool stopped;
+	uint32_t participants[CLOCK_STAGE_COUNT];
+	uint32_t completed[CLOCK_STAGE_COUNT];	// Participants done with the current tick
+	uint32_t deferred[CLOCK_STAGE_COUNT];	// Joined after their turn; take part from the next tick
+	ClockProcess processes[CLOCK_MAX_PROCESSES];	// The same counts, per process
+	pthread_mutex_t mutex;			// Process-shared and robust
+	pthread_cond_t changed;			// Broadcast when the tick or turn moves
+};
+
+class VirtualClock {
+public:
+	VirtualClock();
+	~VirtualClock();
+
+	// Owner (the simulation): create the segment, before tick 1
+	bool create(ClockMode mode, uint32_t stepMs, double speed = 1);
+	// Everyone else: map the segment the owner created
+	bool open();
+	void close();
+	bool isOpen() const;
+
+	// Owner: wait until the next tick is due (CLOCK_MODE_SCALED only), then start it
+	void startTick();
+	// Owner: block until every participant has completed the current tick, dropping
+	// participants whose process has exited
+	void waitTickDone();
+	// Owner: wake every participant for good
+	void stop();
+	// Owner: block until `stage` has at least one participant (or the clock stops)
+	void waitForStage(ClockStage stage);
+
+	uint64_t getTick() const;
+	uint64_t now() const;		// ms
+	uint32_t getStepMs() const;
+	ClockMode getMode() const;
+
+private:
+	friend class ClockParticipant;
+
+	void advanceTurn();
+	void dropDeadProcesses();
+
+	int shm_fd;
+	ClockSegment* segment;
+	bool owner;
+	uint64_t startNs;			// Wall time tick 1 started at, CLOCK_MONOTONIC
+};
+
+// One thread's part in a stage. Joins on construction and leaves on destruction.
+class ClockParticipant {
+public:
+	ClockParticipant(VirtualClock& clock, ClockStage stage);
+	~ClockParticipant();
+
+	// Block until this participant's next tick comes round to its stage; false
+	// once the clock has stopped
+	bool waitTurn();
+	// Done with the tick waitTurn returned for
+	void complete();
+	// waitTurn() then complete() until `due` is true; false once the clock has stopped
+	template <typename Due>
+	bool waitUntil(Due due) {
+		while (waitTurn()) {
+			if (due()) {
+				return true;
+			}
+			complete();
+		}
+		return false;
+	}
+
+	uint64_t now() const;		// ms
+
+private:
+	VirtualClock& clock;
+	ClockStage stage;
+	uint64_t firstTick;			// Tick it joined for; deferred until that tick starts
+	uint64_t nextTick;			// Tick it completes next
+	ClockProcess* process;		// This process's entry in the segment; nullptr if the table was full
+};
+
+#endif /* VIRTUALCLOCK_H_ */
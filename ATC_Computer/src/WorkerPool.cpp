@@ -0,0 +1,64 @@
+#include "WorkerPool.h"
+#include <algorithm>
+
+WorkerPool::WorkerPool(unsigned workers) : workerCount(std::max(workers, 1u)) {
+	if (workerCount > 1) {
+		for (unsigned i = 0; i < workerCount; ++i) {
+			threads.emplace_back(&WorkerPool::worker, this, i);
+		}
+	}
+}
+
+WorkerPool::~WorkerPool() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	start.notify_all();
+	for (std::thread& thread : threads) {
+		if (thread.joinable()) {
+			thread.join();
+		}
+	}
+}
+
+// Hands the job to the workers and waits for all of them
+void WorkerPool::run(const std::function<void(unsigned)>& work) {
+	if (threads.empty()) {
+		work(0);
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock(mutex);
+	job = &work;
+	pending = workerCount;
+	++generation;
+	start.notify_all();
+	done.wait(lock, [this] { return pending == 0; });
+	job = nullptr;
+}
+
+void WorkerPool::worker(unsigned index) {
+	uint64_t seenGeneration = 0;
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true) {
+		start.wait(lock, [&] { return stopping || generation != seenGeneration; });
+		if (stopping) {
+			return;
+		}
+		seenGeneration = generation;
+		const std::function<void(unsigned)>& work = *job;
+
+		lock.unlock();
+		work(index);
+		lock.lock();
+
+		if (--pending == 0) {
+			done.notify_one();
+		}
+	}
+}
+
+unsigned WorkerPool::size() const {
+	return workerCount;
+}
@@ -2,8 +2,51 @@
 #include "OperatorConsole.h"
 #include "CommunicationsSystem.h"
 
-int main() {
-    ComputerSystem computerSystem;
+int main(int argc, char* argv[]) {
+    // Optional settings: --collision-ms <ms> (0, the default, evaluates every radar frame)
+    // --collision-workers <n> (threads sharing each evaluation, default 1)
+    // and --broad-phase grid|sweep (collision broad phase, default grid)
+    // and --clock realtime|virtual (virtual follows the simulation's --clock scaled|lockstep)
+    uint32_t evaluationPeriodMs = 0;
+    unsigned collisionWorkers = 1;
+    BroadPhase broadPhase = BROAD_PHASE_GRID;
+    bool followClock = false;
+    for (int i = 1; i < argc; i += 2) {
+        std::string option = argv[i];
+        // A trailing option without its value is as wrong as an unknown one
+        if (i + 1 == argc) {
+            std::cerr << "Unknown option: " << option << " (no value)" << std::endl;
+            return EXIT_FAILURE;
+        }
+        if (option == "--collision-ms") {
+            evaluationPeriodMs = std::stoul(argv[i + 1]);
+        } else if (option == "--collision-workers") {
+            collisionWorkers = std::stoul(argv[i + 1]);
+        } else if (option == "--broad-phase") {
+            std::string phase = argv[i + 1];
+            if (phase == "grid") {
+                broadPhase = BROAD_PHASE_GRID;
+            } else if (phase == "sweep") {
+                broadPhase = BROAD_PHASE_SWEEP;
+            } else {
+                std::cerr << "Unknown broad phase: " << phase << std::endl;
+                return EXIT_FAILURE;
+            }
+        } else if (option == "--clock") {
+            std::string clock = argv[i + 1];
+            if (clock == "realtime" || clock == "virtual") {
+                followClock = (clock == "virtual");
+            } else {
+                std::cerr << "Unknown clock: " << clock << std::endl;
+                return EXIT_FAILURE;
+            }
+        } else {
+            std::cerr << "Unknown option: " << option << " " << argv[i + 1] << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    ComputerSystem computerSystem(evaluationPeriodMs, collisionWorkers, broadPhase, followClock);
     // Task 4 (You need to first implement Task 3)
     /*
     You need to implement OperatorConsolde to send commands to Aircraft
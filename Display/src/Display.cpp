@@ -4,6 +4,8 @@
 #include <sstream>
 #include <cstring>
 #include <cmath>
+#include <memory>
+#include <algorithm>
 
 
 
@@ -12,7 +14,10 @@ const double AIRSPACE_MAX_X = 100000;
 const double AIRSPACE_MIN_Y = 0;
 const double AIRSPACE_MAX_Y = 100000;
 
-Display::Display() : shm_fd(-1), shared_mem(nullptr), display_channel(nullptr), running(false), lastCollisionTime(0) {}
+// Longest wait for a frame before checking whether to stop
+const uint32_t FRAME_WAIT_TIMEOUT_MS = 1000;
+
+Display::Display(uint32_t periodMs, bool clock) : display_channel(nullptr), running(false), lastCollisionTime(0), appliedReport(0), refreshPeriodMs(periodMs), followClock(clock) {}
 
 Display::~Display() {
     shutdown();
@@ -34,23 +39,13 @@ bool Display::initialize() {
 
 bool Display::initializeSharedMemory() {
     while (true) {
-        shm_fd = shm_open(SHARED_MEMORY_NAME, O_RDONLY, 0666);
-        if (shm_fd == -1) {
+        // The reader checks the layout version and sizes its mapping from the header
+        if (!airspace.open()) {
             std::cout << "Display: Waiting for shared memory...\n";
             sleep(1);
             continue;
         }
 
-        shared_mem = (SharedMemory*)mmap(NULL, sizeof(SharedMemory), PROT_READ, MAP_SHARED, shm_fd, 0);
-
-        if (shared_mem == MAP_FAILED) {
-            std::cerr << "Display: Failed to map shared memory\n";
-            close(shm_fd);
-            shm_fd = -1;
-            sleep(1);
-            continue;
-        }
-
         std::cout << "Display: Shared memory initialized successfully\n";
         return true;
     }
@@ -68,14 +63,7 @@ bool Display::initializeIPCChannel() {
 }
 
 void Display::cleanupSharedMemory() {
-    if (shared_mem && shared_mem != MAP_FAILED) {
-        munmap(shared_mem, sizeof(SharedMemory));
-        shared_mem = nullptr;
-    }
-    if (shm_fd != -1) {
-        close(shm_fd);
-        shm_fd = -1;
-    }
+    airspace.close();
 }
 
 void Display::cleanupIPCChannel() {
@@ -134,104 +122,252 @@ void Display::listenForCollisions() {
         MsgReply(rcvid, 0, &reply, sizeof(reply));
 
         if (msg.type == MessageType::COLLISION_DETECTED) {
-            size_t numPairs = msg.dataSize / sizeof(std::pair<int, int>);
-            std::pair<int, int>* pairs = reinterpret_cast<std::pair<int, int>*>(msg.data.data());
+            // The message holds the alerts that changed since the previous one. If
+            // we missed that one, or the changes did not fit, take the whole set
+            // from the conflict table instead.
+            AlertDelta delta;
+            memcpy(&delta, msg.data.data(), sizeof(delta));
+            if (delta.count == ALERT_DELTA_OVERFLOW || delta.base_report != appliedReport
+                    || delta.count > ALERT_DELTA_CAPACITY) {
+                if (!resyncAlerts()) {
+                    std::cerr << "Display: Failed to read conflict table\n";
+                }
+                continue;
+            }
 
             std::lock_guard<std::mutex> lock(collisionMutex);
+            for (uint32_t i = 0; i < delta.count; i++) {
+                msg_alert alert;
+                memcpy(&alert, msg.data.data() + sizeof(delta) + i * sizeof(alert), sizeof(alert));
+                std::pair<int, int> key(alert.plane1, alert.plane2);
+                if (alert.state == ALERT_RESOLVED) {
+                    collisionAlerts.erase(key);
+                    planesInCollision.clear();  // Rebuilt from the alerts on the next redraw
+                } else {
+                    collisionAlerts[key] = alert;
+                    planesInCollision.insert(alert.plane1);
+                    planesInCollision.insert(alert.plane2);
+                }
+                lastCollisionTime = alert.updated;
+            }
+            appliedReport = delta.report_number;
+        }
+    }
 
-            // **FIX: REPLACE collision data, don't accumulate**
-            // Each message from ComputerSystem contains the COMPLETE current state
-            planesInCollision.clear();
-            collisionPairs.clear();
-
-            // Update collision time
-            lastCollisionTime = shared_mem->timestamp;
+    std::cout << "Display: Collision listener stopped\n";
+}
 
-            // Add all collision pairs from the message
-            for (size_t i = 0; i < numPairs; i++) {
-                planesInCollision.insert(pairs[i].first);
-                planesInCollision.insert(pairs[i].second);
-                collisionPairs.push_back(pairs[i]);
+// Replaces the alerts with the full set in the conflict table, which the
+// ComputerSystem creates before its first report
+bool Display::resyncAlerts() {
+    if (!conflicts.isOpen() && !conflicts.open()) {
+        return false;
+    }
 
-                // Debug output
-                //std::cout << "Display received collision: Plane " << pairs[i].first
-                //          << " ⟷ Plane " << pairs[i].second << "\n";
-            }
+    // Build the new state outside the lock, then swap it in whole
+    ConflictReport report;
+    if (!conflicts.read(report)) {
+        return false;
+    }
 
-            //std::cout << "Display: Total collision pairs stored: " << collisionPairs.size() << "\n";
-        }
+    std::map<std::pair<int, int>, msg_alert> alerts;
+    std::set<int> planes;
+    for (const msg_alert& alert : report.alerts) {
+        alerts[std::make_pair(alert.plane1, alert.plane2)] = alert;
+        planes.insert(alert.plane1);
+        planes.insert(alert.plane2);
     }
 
-    std::cout << "Display: Collision listener stopped\n";
+    std::lock_guard<std::mutex> lock(collisionMutex);
+    collisionAlerts.swap(alerts);
+    planesInCollision.swap(planes);
+    lastCollisionTime = report.timestamp;
+    appliedReport = report.report_number;
+    return true;
 }
 
 void Display::displayAircraft() {
-    ATCTimer timer(1, 0);
+    // Without a period of our own, wake on every frame the Radar publishes
+    // On the virtual clock the same happens in our turn of each tick instead
+    std::unique_ptr<ClockParticipant> participant;
+    std::unique_ptr<ATCTimer> timer;
+    if (followClock) {
+        while (running && !virtualClock.open()) {
+            std::cerr << "Display: Failed to open virtual clock, retrying..." << std::endl;
+            sleep(1);
+        }
+        if (virtualClock.isOpen()) {
+            participant.reset(new ClockParticipant(virtualClock, CLOCK_STAGE_DISPLAY));
+        }
+    } else if (refreshPeriodMs) {
+        timer.reset(new ATCTimer(refreshPeriodMs / 1000, refreshPeriodMs % 1000));
+    }
+    uint64_t seenFrame = 0;
+    uint64_t nextRefreshMs = 0;
+    bool inTurn = false;
+    auto due = [&]() {
+        if (refreshPeriodMs) {
+            return participant->now() >= nextRefreshMs;
+        }
+        uint64_t latest = airspace.waitForFrame(seenFrame, 0);
+        bool published = (latest != seenFrame);
+        seenFrame = latest;
+        return published;
+    };
+    auto waitNext = [&]() {
+        if (participant) {
+            if (inTurn) {
+                participant->complete();
+            }
+            inTurn = participant->waitUntil(due);
+            if (!inTurn) {
+                running = false;  // The simulation stopped the clock
+            }
+            nextRefreshMs = participant->now() + refreshPeriodMs;
+        } else if (timer) {
+            timer->waitTimer();
+        } else {
+            seenFrame = airspace.waitForFrame(seenFrame, FRAME_WAIT_TIMEOUT_MS);
+        }
+    };
     std::cout << "Display: Aircraft display thread started\n";
 
-    while (running && shared_mem->is_empty.load()) {
+    while (running && airspace.isEmpty()) {
         std::cout << "Display: Waiting for aircraft to enter airspace...\n";
-        timer.waitTimer();
+        waitNext();
     }
 
+    std::vector<msg_plane_info> planes;
     while (running) {
-        if (shared_mem->is_empty.load()) {
+        // Follow the Radar's frame deltas instead of copying the whole frame every refresh
+        if (tracker.update(airspace)) {
+            printChanges();
+        }
+        if (tracker.getPlanes().empty()) {
 
             std::cout << "\n=== AIRSPACE EMPTY - ALL AIRCRAFT HAVE DEPARTED ===\n";
             running = false;
             break;
         }
 
-        std::vector<msg_plane_info> planes;
-        int count = shared_mem->count;
-
-        for (int i = 0; i < count && i < 100; i++) {
-            planes.push_back(shared_mem->plane_data[i]);
-        }
-
-        printAirspaceGrid(planes);
-        timer.waitTimer();
+        tracker.extrapolate(tracker.getTimestamp(), planes);
+        printAirspaceGrid(PlaneView::ofStructs(planes.data(), planes.size()));
+        waitNext();
     }
 
     std::cout << "Display: Aircraft display thread stopped\n";
 }
 
-void Display::printAirspaceGrid(const std::vector<msg_plane_info>& planes) {
-    std::lock_guard<std::mutex> lock(collisionMutex);
+void Display::printChanges() {
+    if (tracker.wasRebuilt()) {
+        std::cout << "Display: synced to frame " << tracker.getFrameNumber() << "\n";
+    }
 
-    std::set<int> activePlaneIDs;
-    for (const auto& plane : planes) {
-        activePlaneIDs.insert(plane.id);
+    for (const msg_plane_change& change : tracker.getChanges()) {
+        switch (change.kind) {
+            case PLANE_ENTERED:
+                std::cout << "  Aircraft " << change.id << " entered the airspace\n";
+                break;
+            case PLANE_EXITED:
+                std::cout << "  Aircraft " << change.id << " left the airspace\n";
+                break;
+            default:
+                std::cout << "  Aircraft " << change.id << " changed course\n";
+                break;
+        }
     }
+}
 
-    // Remove collision pairs involving planes that have left
-    std::vector<std::pair<int, int>> validCollisionPairs;
-    std::set<int> validPlanesInCollision;
+void Display::printAirspaceGrid(const PlaneView& planes) {
+    // The advisories change every evaluation, so they are not sent but read here
+    ConflictReport advice;
+    if (advisoryTable.isOpen() || advisoryTable.open()) {
+        advisoryTable.readAdvisories(advice);
+    }
 
-    for (const auto& pair : collisionPairs) {
-        // Check if both planes are still in airspace
-        bool plane1Active = activePlaneIDs.find(pair.first) != activePlaneIDs.end();
-        bool plane2Active = activePlaneIDs.find(pair.second) != activePlaneIDs.end();
+    std::lock_guard<std::mutex> lock(collisionMutex);
 
-        if (plane1Active && plane2Active) {
-            // Both planes still in airspace - keep this collision pair
-            validCollisionPairs.push_back(pair);
-            validPlanesInCollision.insert(pair.first);
-            validPlanesInCollision.insert(pair.second);
+    // Remove alerts involving planes that have left
+    const auto& activePlanes = tracker.getPlanes();
+    planesInCollision.clear();
+    for (auto it = collisionAlerts.begin(); it != collisionAlerts.end();) {
+        const msg_alert& alert = it->second;
+        if (activePlanes.find(alert.plane1) == activePlanes.end() || activePlanes.find(alert.plane2) == activePlanes.end()) {
+            it = collisionAlerts.erase(it);
+            continue;
         }
+        planesInCollision.insert(alert.plane1);
+        planesInCollision.insert(alert.plane2);
+        ++it;
     }
-    
-    collisionPairs = validCollisionPairs;
-    planesInCollision = validPlanesInCollision;
 
-    if (!collisionPairs.empty()) {
+    if (!collisionAlerts.empty()) {
 
         std::cout << "ACTIVE COLLISION WARNINGS:\n";
 
-        for (const auto& pair : collisionPairs) {
-            std::cout << " Aircraft " << std::setw(2) << pair.first
-                      << " Aircraft " << std::setw(2) << pair.second
-                      << "\n";
+        // Alerts carry the frame time they were predicted from; count down from there
+        uint64_t now = tracker.getTimestamp();
+        for (const auto& entry : collisionAlerts) {
+            const msg_alert& alert = entry.second;
+            float elapsed = now > alert.updated ? (now - alert.updated) / 1000.0f : 0;
+            float conflictIn = std::max(alert.conflictTime - elapsed, 0.0f);
+            float closestIn = std::max(alert.closestApproach - elapsed, 0.0f);
+
+            std::cout << " Aircraft " << std::setw(2) << alert.plane1
+                      << " Aircraft " << std::setw(2) << alert.plane2;
+            switch (alert.state) {
+                case ALERT_NEW:       std::cout << "  NEW      "; break;
+                case ALERT_ESCALATED: std::cout << "  ESCALATED"; break;
+                default:              std::cout << "  ONGOING  "; break;
+            }
+            // Lookahead horizons the conflict falls within; higher is sooner
+            std::cout << "  severity " << alert.severity;
+            if (conflictIn > 0) {
+                std::cout << "  separation lost in " << std::fixed << std::setprecision(1)
+                          << conflictIn << "s";
+            } else {
+                std::cout << "  separation lost";
+            }
+            std::cout << ", closest in " << std::fixed << std::setprecision(1)
+                      << closestIn << "s";
+            std::cout << ", alert age " << std::fixed << std::setprecision(1)
+                      << (now > alert.firstSeen ? (now - alert.firstSeen) / 1000.0 : 0.0) << "s\n";
+        }
+
+    }
+
+    if (!advice.advisories.empty()) {
+
+        std::cout << "RESOLUTION ADVISORIES:\n";
+
+        for (const msg_advisory& advisory : advice.advisories) {
+            const msg_change_heading& command = advisory.command;
+            std::cout << " Cluster " << std::setw(2) << advisory.cluster << " #" << advisory.rank
+                      << "  Aircraft " << std::setw(2) << command.ID << std::fixed << std::setprecision(0);
+            switch (advisory.maneuver) {
+                case ADVISORY_HEADING:
+                    std::cout << " turn " << (advisory.change > 0 ? "left " : "right ") << std::fabs(advisory.change) << " deg";
+                    break;
+                case ADVISORY_ALTITUDE:
+                    std::cout << (advisory.change > 0 ? " climb " : " descend ") << std::fabs(advisory.change);
+                    break;
+                default:
+                    std::cout << (advisory.change > 0 ? " speed up " : " slow down ") << std::fabs(advisory.change) * 100 << "%";
+                    break;
+            }
+
+            // Ready to type into the Operator Console
+            if (advisory.maneuver == ADVISORY_ALTITUDE) {
+                std::cout << "  (altitude " << command.ID << " " << command.altitude << ")";
+            } else {
+                std::cout << "  (heading " << command.ID << " " << command.VelocityX << " "
+                          << command.VelocityY << " " << command.VelocityZ << ")";
+            }
+            std::cout << "  clears " << advisory.resolved << " of " << advisory.conflicts;
+            if (advisory.introduced) {
+                std::cout << ", causes " << advisory.introduced;
+            }
+            std::cout << "\n";
         }
 
     }
@@ -239,16 +375,17 @@ void Display::printAirspaceGrid(const std::vector<msg_plane_info>& planes) {
     std::cout << "\n Aircraft Details:\n";
     std::cout << "-------------------------------------------------------------------------\n";
 
-    for (const auto& plane : planes) {
+    for (uint32_t i = 0; i < planes.size(); i++) {
+        msg_plane_info plane = planes.at(i);
         bool inCollision = planesInCollision.find(plane.id) != planesInCollision.end();
 
         std::vector<int> collisionPartners;
         if (inCollision) {
-            for (const auto& pair : collisionPairs) {
-                if (pair.first == plane.id) {
-                    collisionPartners.push_back(pair.second);
-                } else if (pair.second == plane.id) {
-                    collisionPartners.push_back(pair.first);
+            for (const auto& entry : collisionAlerts) {
+                if (entry.first.first == plane.id) {
+                    collisionPartners.push_back(entry.first.second);
+                } else if (entry.first.second == plane.id) {
+                    collisionPartners.push_back(entry.first.first);
                 }
             }
         }
@@ -261,6 +398,10 @@ void Display::printAirspaceGrid(const std::vector<msg_plane_info>& planes) {
                   << std::setw(4) << (int)plane.VelocityY << ","
                   << std::setw(4) << (int)plane.VelocityZ << ")";
 
+        if (plane.flags & PLANE_INFO_STALE) {
+            std::cout << " STALE";
+        }
+
         if (inCollision && !collisionPartners.empty()) {
             std::cout << " COLLISION WITH: Plane";
             for (size_t i = 0; i < collisionPartners.size(); i++) {
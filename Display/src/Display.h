@@ -6,6 +6,7 @@
 #include <atomic>
 #include <vector>
 #include <set>
+#include <map>
 #include <mutex>
 #include <utility>
 #include <fcntl.h>
@@ -16,16 +17,20 @@
 #include <unistd.h>
 #include <errno.h>
 #include "Msg_structs.h"
+#include "SharedAirspace.h"
+#include "ConflictTable.h"
+#include "VirtualClock.h"
 
 // Display channel name
 #define DISPLAY_CHANNEL_NAME "40247851_40228573_Display"
 
-// Shared memory name
-#define SHARED_MEMORY_NAME "/tmp/AH_40247851_40228573_Radar_shm"
-
 class Display {
 public:
-    Display();
+    // refreshPeriodMs is the time between two redraws of the airspace;
+    // 0 redraws on every frame the Radar publishes
+    // followClock runs on the simulation's virtual clock: once per tick, last of all stages,
+    // with refreshPeriodMs counted in virtual time
+    Display(uint32_t refreshPeriodMs = 0, bool followClock = false);
     ~Display();
 
 
@@ -35,8 +40,8 @@ public:
 
 private:
 
-    int shm_fd;
-    SharedMemory* shared_mem;
+    AirspaceReader airspace;
+    AirspaceTracker tracker;
 
     name_attach_t* display_channel;
 
@@ -47,9 +52,15 @@ private:
     std::atomic<bool> running;
 
     std::set<int> planesInCollision;
-    std::vector<std::pair<int, int>> collisionPairs;
+    std::map<std::pair<int, int>, msg_alert> collisionAlerts;  // By plane pair
     std::mutex collisionMutex;
     uint64_t lastCollisionTime;
+    uint64_t appliedReport;         // ComputerSystem report the alerts reflect
+    ConflictTableReader conflicts;  // Full alert set, to resynchronise from
+    ConflictTableReader advisoryTable;  // Resolution advisories, read on every redraw
+    uint32_t refreshPeriodMs;
+    bool followClock;
+    VirtualClock virtualClock;  // Opened by the display thread when followClock is set
 
 
     bool initializeSharedMemory();
@@ -62,9 +73,11 @@ private:
 
     void displayAircraft();
     void listenForCollisions();
+    bool resyncAlerts();
 
 
-    void printAirspaceGrid(const std::vector<msg_plane_info>& planes);
+    void printChanges();
+    void printAirspaceGrid(const PlaneView& planes);
     void clearScreen();
 
 
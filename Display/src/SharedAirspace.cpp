@@ -0,0 +1,869 @@
+#include "SharedAirspace.h"
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "ReadBackOff.h"
+
+namespace {
+
+// The frame mutex only guards the wait on frame_ready, so a holder that died
+// left nothing half-done behind it
+void lockFrameMutex(pthread_mutex_t* mutex) {
+	if (pthread_mutex_lock(mutex) == EOWNERDEAD) {
+		pthread_mutex_consistent(mutex);
+	}
+}
+
+}
+
+AirspaceWriter::AirspaceWriter() : shm_fd(-1), shared_mem(nullptr), mappedCapacity(0), mappedDepth(0), frameLayout(FRAME_LAYOUT_AOS), nextFrame(1),
+	keyframeInterval(AIRSPACE_DEFAULT_KEYFRAME_INTERVAL), framesSinceKeyframe(0), keyframePending(true) {}
+
+AirspaceWriter::~AirspaceWriter() {
+	close();
+}
+
+bool AirspaceWriter::open(uint32_t initialCapacity, uint32_t historyDepth, uint32_t interval, uint32_t layout) {
+	keyframeInterval = std::max<uint32_t>(interval, 1);
+	frameLayout = (layout == FRAME_LAYOUT_SOA) ? FRAME_LAYOUT_SOA : FRAME_LAYOUT_AOS;
+
+	// Readers may still be blocked on the notification objects of an earlier
+	// Radar's segment, so those are never initialized twice: retire that segment
+	// and create a fresh one under the same name
+	uint32_t generation = retirePrevious();
+	shm_unlink(AIRSPACE_SHM_NAME);
+	shm_fd = shm_open(AIRSPACE_SHM_NAME, O_CREAT | O_EXCL | O_RDWR, 0666);
+	if (shm_fd == -1) {
+		std::cerr << "Failed to open shared memory" << std::endl;
+		return false;
+	}
+
+	if (!resize(std::max<uint32_t>(initialCapacity, 1), std::max<uint32_t>(historyDepth, 1))) {
+		close();
+		return false;
+	}
+
+	// Readers only open a segment with the current version, so hide it until the
+	// notification objects are set up
+	shared_mem->layout_version = 0;
+	pthread_mutexattr_t mutexAttr;
+	pthread_mutexattr_init(&mutexAttr);
+	pthread_mutexattr_setpshared(&mutexAttr, PTHREAD_PROCESS_SHARED);
+	pthread_mutexattr_setrobust(&mutexAttr, PTHREAD_MUTEX_ROBUST);
+	pthread_mutex_init(&shared_mem->frame_mutex, &mutexAttr);
+	pthread_mutexattr_destroy(&mutexAttr);
+
+	pthread_condattr_t condAttr;
+	pthread_condattr_init(&condAttr);
+	pthread_condattr_setpshared(&condAttr, PTHREAD_PROCESS_SHARED);
+	pthread_condattr_setclock(&condAttr, CLOCK_MONOTONIC);
+	pthread_cond_init(&shared_mem->frame_ready, &condAttr);
+	pthread_condattr_destroy(&condAttr);
+
+	shared_mem->waiters.store(0, std::memory_order_relaxed);
+	shared_mem->retired.store(false, std::memory_order_relaxed);
+	// Carry on from the old segment's generation, so readers that switch over rebuild
+	// instead of taking our frame numbers as a continuation of its own
+	shared_mem->generation.store(generation, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	shared_mem->layout_version = AIRSPACE_LAYOUT_VERSION;
+
+	clear();
+	return true;
+}
+
+void AirspaceWriter::close() {
+	if (shared_mem) {
+		munmap(shared_mem, sharedMemorySize(mappedCapacity, mappedDepth, frameLayout));
+		shared_mem = nullptr;
+		mappedCapacity = 0;
+		mappedDepth = 0;
+	}
+	if (shm_fd != -1) {
+		::close(shm_fd);
+		shm_fd = -1;
+	}
+}
+
+// Maps the segment with a new frame size and ring depth. The generation only goes
+// odd once the new mapping exists, so a failed resize leaves the old layout
+// published; and the file only grows, so readers still holding the old mapping
+// never fault.
+bool AirspaceWriter::resize(uint32_t capacity, uint32_t depth) {
+	size_t size = sharedMemorySize(capacity, depth, frameLayout);
+	struct stat shm_stat;
+	if (fstat(shm_fd, &shm_stat) == -1 || (size_t)shm_stat.st_size < size) {
+		if (ftruncate(shm_fd, size) == -1) {
+			std::cerr << "Failed to set shared memory size" << std::endl;
+			return false;
+		}
+	}
+
+	void* mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
+	if (mapping == MAP_FAILED) {
+		std::cerr << "Failed to map shared memory" << std::endl;
+		return false;
+	}
+
+	if (shared_mem) {
+		munmap(shared_mem, sharedMemorySize(mappedCapacity, mappedDepth, frameLayout));
+	}
+	shared_mem = static_cast<SharedMemory*>(mapping);
+	mappedCapacity = capacity;
+	mappedDepth = depth;
+
+	// Odd while the header and ring change; a crashed Radar may have left it odd already
+	uint32_t generation = shared_mem->generation.load(std::memory_order_relaxed);
+	if (!(generation & 1)) {
+		shared_mem->generation.store(++generation, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+	}
+
+	shared_mem->capacity.store(capacity, std::memory_order_relaxed);
+	shared_mem->history_depth.store(depth, std::memory_order_relaxed);
+	shared_mem->frame_layout.store(frameLayout, std::memory_order_relaxed);
+	resetRing();
+
+	shared_mem->generation.store(generation + 1, std::memory_order_release);
+	return true;
+}
+
+// Marks the segment of an earlier Radar retired and wakes its waiters so they
+// switch to ours. Returns the (even) generation to continue from.
+uint32_t AirspaceWriter::retirePrevious() {
+	int fd = shm_open(AIRSPACE_SHM_NAME, O_RDWR, 0666);
+	if (fd == -1) {
+		return 0;
+	}
+
+	uint32_t generation = 0;
+	struct stat shm_stat;
+	if (fstat(fd, &shm_stat) == 0 && (size_t)shm_stat.st_size >= sizeof(SharedMemory)) {
+		void* mapping = mmap(NULL, sizeof(SharedMemory), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (mapping != MAP_FAILED) {
+			SharedMemory* previous = static_cast<SharedMemory*>(mapping);
+			// Readers of another layout version never opened it, so nobody waits there
+			if (previous->layout_version == AIRSPACE_LAYOUT_VERSION) {
+				generation = (previous->generation.load(std::memory_order_relaxed) | 1) + 1;
+				previous->retired.store(true, std::memory_order_release);
+				lockFrameMutex(&previous->frame_mutex);
+				pthread_cond_broadcast(&previous->frame_ready);
+				pthread_mutex_unlock(&previous->frame_mutex);
+			}
+			munmap(mapping, sizeof(SharedMemory));
+		}
+	}
+	::close(fd);
+	return generation;
+}
+
+// Marks every slot as unwritten. Callers hold the generation odd around this.
+void AirspaceWriter::resetRing() {
+	for (uint32_t i = 0; i < mappedDepth; ++i) {
+		RadarFrame* frame = frameAt(shared_mem, mappedCapacity, frameLayout, i);
+		frame->sequence.store(0, std::memory_order_relaxed);
+		frame->count = 0;
+		frame->frame_number = 0;
+		frame->timestamp = 0;
+		frame->change_count = 0;
+		frame->flags = 0;
+	}
+	// Readers lose the frame they were following, so the next one has to be complete on its own
+	keyframePending = true;
+}
+
+// Merges the new frame against the previous one (both sorted by id) into a change list.
+// Exits are bounded by the previous frame and entries plus updates by the new one,
+// so the list never needs more than the 2 * capacity slots reserved for it.
+uint32_t AirspaceWriter::diff(const msg_plane_info* planes, size_t count, msg_plane_change* changes) const {
+	uint32_t changeCount = 0;
+	size_t i = 0, j = 0;
+	while (i < previousFrame.size() || j < count) {
+		if (j == count || (i < previousFrame.size() && previousFrame[i].id < planes[j].id)) {
+			changes[changeCount++] = {previousFrame[i++].id, PLANE_EXITED};
+		} else if (i == previousFrame.size() || planes[j].id < previousFrame[i].id) {
+			changes[changeCount++] = {planes[j++].id, PLANE_ENTERED};
+		} else {
+			if (planeChanged(previousFrame[i], planes[j])) {
+				changes[changeCount++] = {planes[j].id, PLANE_UPDATED};
+			}
+			++i;
+			++j;
+		}
+	}
+	return changeCount;
+}
+
+void AirspaceWriter::publish(const std::vector<msg_plane_info>& planes, uint64_t timestamp) {
+	if (!shared_mem) {
+		return;
+	}
+
+	size_t count = planes.size();
+	if (count > mappedCapacity && !resize(std::max<size_t>(count, mappedCapacity * 2), mappedDepth)) {
+		std::cerr << "Radar: frame of " << count << " planes truncated to " << mappedCapacity << std::endl;
+		count = mappedCapacity;
+	}
+
+	uint64_t number = nextFrame++;
+	RadarFrame* frame = frameAt(shared_mem, mappedCapacity, frameLayout, number % mappedDepth);
+
+	bool keyframe = keyframePending || ++framesSinceKeyframe >= keyframeInterval;
+	if (keyframe) {
+		keyframePending = false;
+		framesSinceKeyframe = 0;
+	}
+
+	uint32_t sequence = frame->sequence.load(std::memory_order_relaxed);
+	frame->sequence.store(sequence + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	frame->frame_number = number;
+	frame->timestamp = timestamp;
+	frame->count = count;
+	writePlanes(frame, planes, count);
+	frame->change_count = diff(planes.data(), count, changeData(frame, mappedCapacity, frameLayout));
+	frame->flags = keyframe ? FRAME_KEYFRAME : 0;
+
+	frame->sequence.store(sequence + 2, std::memory_order_release);
+	previousFrame.assign(planes.begin(), planes.begin() + count);
+
+	shared_mem->is_empty.store(count == 0, std::memory_order_release);
+	shared_mem->latest_frame.store(number, std::memory_order_release);
+	notifyReaders();
+}
+
+// One memcpy for AoS; SoA scatters every struct into the columns
+void AirspaceWriter::writePlanes(RadarFrame* frame, const std::vector<msg_plane_info>& planes, size_t count) {
+	char* region = planeRegion(frame);
+	if (frameLayout == FRAME_LAYOUT_AOS) {
+		std::memcpy(region, planes.data(), count * sizeof(msg_plane_info));
+		return;
+	}
+
+	int* id = reinterpret_cast<int*>(region + soaColumnOffset(mappedCapacity, COLUMN_ID));
+	int* flags = reinterpret_cast<int*>(region + soaColumnOffset(mappedCapacity, COLUMN_FLAGS));
+	double* x = reinterpret_cast<double*>(region + soaColumnOffset(mappedCapacity, COLUMN_X));
+	double* y = reinterpret_cast<double*>(region + soaColumnOffset(mappedCapacity, COLUMN_Y));
+	double* z = reinterpret_cast<double*>(region + soaColumnOffset(mappedCapacity, COLUMN_Z));
+	double* vx = reinterpret_cast<double*>(region + soaColumnOffset(mappedCapacity, COLUMN_VX));
+	double* vy = reinterpret_cast<double*>(region + soaColumnOffset(mappedCapacity, COLUMN_VY));
+	double* vz = reinterpret_cast<double*>(region + soaColumnOffset(mappedCapacity, COLUMN_VZ));
+	for (size_t i = 0; i < count; ++i) {
+		const msg_plane_info& plane = planes[i];
+		id[i] = plane.id;
+		flags[i] = plane.flags;
+		x[i] = plane.PositionX;
+		y[i] = plane.PositionY;
+		z[i] = plane.PositionZ;
+		vx[i] = plane.VelocityX;
+		vy[i] = plane.VelocityY;
+		vz[i] = plane.VelocityZ;
+	}
+}
+
+// Wakes readers blocked in waitForFrame. The fence pairs with the one in
+// waitForFrame: either we see the reader's waiter count, or it sees the new
+// latest_frame before it goes to sleep. Skips the mutex when nobody waits.
+void AirspaceWriter::notifyReaders() {
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (shared_mem->waiters.load(std::memory_order_relaxed) == 0) {
+		return;
+	}
+	lockFrameMutex(&shared_mem->frame_mutex);
+	pthread_cond_broadcast(&shared_mem->frame_ready);
+	pthread_mutex_unlock(&shared_mem->frame_mutex);
+}
+
+void AirspaceWriter::clear() {
+	if (!shared_mem) {
+		return;
+	}
+
+	uint32_t generation = shared_mem->generation.load(std::memory_order_relaxed);
+	shared_mem->generation.store(generation + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	resetRing();
+	nextFrame = 1;
+	previousFrame.clear();
+	shared_mem->latest_frame.store(0, std::memory_order_relaxed);
+	shared_mem->is_empty.store(true, std::memory_order_relaxed);
+	shared_mem->start = false;
+
+	shared_mem->generation.store(generation + 2, std::memory_order_release);
+	notifyReaders();
+}
+
+uint32_t AirspaceWriter::getCapacity() const {
+	return mappedCapacity;
+}
+
+uint32_t AirspaceWriter::getHistoryDepth() const {
+	return mappedDepth;
+}
+
+uint32_t AirspaceWriter::getFrameLayout() const {
+	return frameLayout;
+}
+
+
+AirspaceReader::AirspaceReader() : shm_fd(-1), shared_mem(nullptr), notify_mem(nullptr), mappedCapacity(0), mappedDepth(0),
+	mappedLayout(FRAME_LAYOUT_AOS), mappedGeneration(1) {}
+
+AirspaceReader::~AirspaceReader() {
+	close();
+}
+
+bool AirspaceReader::open() {
+	shm_fd = shm_open(AIRSPACE_SHM_NAME, O_RDWR, 0666);
+	if (shm_fd == -1) {
+		return false;
+	}
+
+	// Map just the header first, then size the mapping from what the Radar recorded
+	if (!remap(0, 0, FRAME_LAYOUT_AOS)) {
+		close();
+		return false;
+	}
+
+	if (shared_mem->layout_version != AIRSPACE_LAYOUT_VERSION) {
+		std::cerr << "Shared memory layout version " << shared_mem->layout_version
+				  << " does not match expected " << AIRSPACE_LAYOUT_VERSION << std::endl;
+		close();
+		return false;
+	}
+
+	void* header = mmap(NULL, sizeof(SharedMemory), PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
+	if (header == MAP_FAILED) {
+		close();
+		return false;
+	}
+	notify_mem = static_cast<SharedMemory*>(header);
+
+	if (!refreshMapping()) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+void AirspaceReader::close() {
+	if (notify_mem) {
+		munmap(notify_mem, sizeof(SharedMemory));
+		notify_mem = nullptr;
+	}
+	if (shared_mem) {
+		munmap(const_cast<SharedMemory*>(shared_mem), sharedMemorySize(mappedCapacity, mappedDepth, mappedLayout));
+		shared_mem = nullptr;
+		mappedCapacity = 0;
+		mappedDepth = 0;
+	}
+	if (shm_fd != -1) {
+		::close(shm_fd);
+		shm_fd = -1;
+	}
+}
+
+bool AirspaceReader::remap(uint32_t capacity, uint32_t depth, uint32_t layout) {
+	// Never map past the end of the file; that would fault on access
+	size_t size = sharedMemorySize(capacity, depth, layout);
+	struct stat shm_stat;
+	if (fstat(shm_fd, &shm_stat) == -1 || (size_t)shm_stat.st_size < size) {
+		return false;
+	}
+
+	void* mapping = mmap(NULL, size, PROT_READ, MAP_SHARED, shm_fd, 0);
+	if (mapping == MAP_FAILED) {
+		return false;
+	}
+
+	if (shared_mem) {
+		munmap(const_cast<SharedMemory*>(shared_mem), sharedMemorySize(mappedCapacity, mappedDepth, mappedLayout));
+	}
+	shared_mem = static_cast<const SharedMemory*>(mapping);
+	mappedCapacity = capacity;
+	mappedDepth = depth;
+	mappedLayout = layout;
+	return true;
+}
+
+// Picks up a layout change published by the Radar. Returns false while the
+// Radar is still in the middle of one.
+bool AirspaceReader::refreshMapping() {
+	uint32_t generation = shared_mem->generation.load(std::memory_order_acquire);
+	if (generation & 1) {
+		return false;
+	}
+
+	uint32_t capacity = shared_mem->capacity.load(std::memory_order_relaxed);
+	uint32_t depth = shared_mem->history_depth.load(std::memory_order_relaxed);
+	uint32_t layout = shared_mem->frame_layout.load(std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_acquire);
+	if (shared_mem->generation.load(std::memory_order_relaxed) != generation) {
+		return false;
+	}
+
+	if ((capacity != mappedCapacity || depth != mappedDepth || layout != mappedLayout) && !remap(capacity, depth, layout)) {
+		return false;
+	}
+	mappedGeneration = generation;
+	return true;
+}
+
+bool AirspaceReader::frameBack(uint32_t k, FrameView& view) {
+	return findFrame(k, 0, view);
+}
+
+bool AirspaceReader::frameNumbered(uint64_t number, FrameView& view) {
+	return number != 0 && findFrame(0, number, view);
+}
+
+// Looks a frame up by its distance k from the newest, or by its number when `number` is non-zero
+bool AirspaceReader::findFrame(uint32_t k, uint64_t wanted, FrameView& view) {
+	uint32_t attempt = 0;
+	while (true) {
+		uint32_t generation = shared_mem->generation.load(std::memory_order_acquire);
+		if (generation != mappedGeneration) {
+			if (!refreshMapping() && !backOff(attempt)) {
+				return false;
+			}
+			continue;
+		}
+
+		uint64_t latest = shared_mem->latest_frame.load(std::memory_order_acquire);
+		if (wanted) {
+			if (wanted > latest || latest - wanted >= mappedDepth) {
+				return false;
+			}
+			k = latest - wanted;
+		}
+		if (latest == 0 || k >= mappedDepth || k >= latest) {
+			return false;
+		}
+
+		uint64_t number = latest - k;
+		const RadarFrame* frame = frameAt(shared_mem, mappedCapacity, mappedLayout, number % mappedDepth);
+		uint32_t sequence = frame->sequence.load(std::memory_order_acquire);
+		if ((sequence & 1) || frame->frame_number != number) {
+			// Only the newest frame can still be worth waiting for (a one-slot ring)
+			if (k == 0 && backOff(attempt)) {
+				continue;
+			}
+			return false;
+		}
+
+		view.frame_number = number;
+		view.timestamp = frame->timestamp;
+		view.count = std::min(frame->count, mappedCapacity);
+		if (mappedLayout == FRAME_LAYOUT_SOA) {
+			view.planes = PlaneView::ofRegion(planeRegion(frame), mappedCapacity, view.count);
+		} else {
+			view.planes = PlaneView::ofStructs(reinterpret_cast<const msg_plane_info*>(planeRegion(frame)), view.count);
+		}
+		view.flags = frame->flags;
+		view.change_count = std::min(frame->change_count, 2 * mappedCapacity);
+		view.changes = changeData(frame, mappedCapacity, mappedLayout);
+		view.frame = frame;
+		view.sequence = sequence;
+		view.generation = generation;
+		return true;
+	}
+}
+
+bool AirspaceReader::validate(const FrameView& view) const {
+	std::atomic_thread_fence(std::memory_order_acquire);
+	return view.frame->sequence.load(std::memory_order_relaxed) == view.sequence
+		&& shared_mem->generation.load(std::memory_order_relaxed) == view.generation;
+}
+
+uint64_t AirspaceReader::waitForFrame(uint64_t after, uint32_t timeoutMs) {
+	if (notify_mem->retired.load(std::memory_order_acquire)) {
+		reopen();
+	}
+
+	// A poll never touches the mutex or the waiter count, so it costs the Radar nothing
+	uint64_t latest = notify_mem->latest_frame.load(std::memory_order_acquire);
+	if (latest != after || timeoutMs == 0) {
+		return latest;
+	}
+
+	struct timespec deadline;
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	deadline.tv_sec += timeoutMs / 1000;
+	deadline.tv_nsec += static_cast<long>(timeoutMs % 1000) * 1000000;
+	if (deadline.tv_nsec >= 1000000000) {
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000;
+	}
+
+	lockFrameMutex(&notify_mem->frame_mutex);
+	notify_mem->waiters.fetch_add(1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	while ((latest = notify_mem->latest_frame.load(std::memory_order_acquire)) == after
+		   && !notify_mem->retired.load(std::memory_order_acquire)) {
+		int result = pthread_cond_timedwait(&notify_mem->frame_ready, &notify_mem->frame_mutex, &deadline);
+		if (result == EOWNERDEAD) {
+			pthread_mutex_consistent(&notify_mem->frame_mutex);
+		} else if (result == ETIMEDOUT) {
+			latest = notify_mem->latest_frame.load(std::memory_order_acquire);
+			break;
+		}
+	}
+	notify_mem->waiters.fetch_sub(1, std::memory_order_relaxed);
+	pthread_mutex_unlock(&notify_mem->frame_mutex);
+
+	// Woken because the Radar restarted: wait on the new segment from its next call
+	if (latest == after && notify_mem->retired.load(std::memory_order_acquire) && reopen()) {
+		latest = notify_mem->latest_frame.load(std::memory_order_acquire);
+	}
+	return latest;
+}
+
+// Switches to the segment of a restarted Radar. Keeps the retired one (and its
+// last frames) until the new one is ready.
+bool AirspaceReader::reopen() {
+	AirspaceReader fresh;
+	if (!fresh.open() || fresh.notify_mem->retired.load(std::memory_order_acquire)) {
+		return false;
+	}
+	std::swap(shm_fd, fresh.shm_fd);
+	std::swap(shared_mem, fresh.shared_mem);
+	std::swap(notify_mem, fresh.notify_mem);
+	std::swap(mappedCapacity, fresh.mappedCapacity);
+	std::swap(mappedDepth, fresh.mappedDepth);
+	std::swap(mappedLayout, fresh.mappedLayout);
+	std::swap(mappedGeneration, fresh.mappedGeneration);
+	return true;
+}
+
+bool AirspaceReader::readSnapshot(std::vector<msg_plane_info>& planes, uint64_t& timestamp) {
+	while (true) {
+		FrameView view;
+		if (!frameBack(0, view)) {
+			planes.clear();
+			return false;
+		}
+
+		view.planes.copyTo(planes);
+		timestamp = view.timestamp;
+		if (validate(view)) {
+			return !planes.empty();
+		}
+	}
+}
+
+bool AirspaceReader::isEmpty() const {
+	return shared_mem->is_empty.load(std::memory_order_acquire);
+}
+
+uint64_t AirspaceReader::getTimestamp() {
+	FrameView view;
+	if (!frameBack(0, view)) {
+		return 0;
+	}
+	uint64_t timestamp = view.timestamp;
+	return validate(view) ? timestamp : 0;
+}
+
+uint32_t AirspaceReader::getCapacity() const {
+	return mappedCapacity;
+}
+
+uint32_t AirspaceReader::getHistoryDepth() const {
+	return mappedDepth;
+}
+
+uint32_t AirspaceReader::getFrameLayout() const {
+	return mappedLayout;
+}
+
+
+AirspaceTracker::AirspaceTracker() : frameNumber(0), timestamp(0), generation(0), rebuilt(false) {}
+
+bool AirspaceTracker::update(AirspaceReader& reader) {
+	FrameView view;
+	if (!reader.frameBack(0, view)) {
+		return false;
+	}
+	if (view.frame_number == frameNumber && view.generation == generation) {
+		return false;
+	}
+
+	changes.clear();
+	bool following = frameNumber != 0 && view.generation == generation && view.frame_number > frameNumber;
+	if (following && applyDeltas(reader, view.frame_number)) {
+		rebuilt = false;
+		return true;
+	}
+
+	rebuilt = true;
+	return rebuild(reader) || !changes.empty();
+}
+
+// Applies the change lists of frames frameNumber + 1 .. latest in order. Stops
+// (returning false) at a keyframe or at a frame that is gone or was overwritten
+// while being read; whatever was applied up to there stays applied.
+bool AirspaceTracker::applyDeltas(AirspaceReader& reader, uint64_t latest) {
+	for (uint64_t number = frameNumber + 1; number <= latest; ++number) {
+		FrameView view;
+		if (!reader.frameNumbered(number, view) || view.generation != generation || (view.flags & FRAME_KEYFRAME)) {
+			return false;
+		}
+
+		staged.clear();
+		for (uint32_t i = 0; i < view.change_count; ++i) {
+			msg_plane_change change = view.changes[i];
+			msg_plane_info info = {};
+			if (change.kind != PLANE_EXITED) {
+				int index = view.planes.find(change.id);
+				if (index < 0) {
+					return false;
+				}
+				info = view.planes.at(index);
+			}
+			staged.emplace_back(change, info);
+		}
+		if (!reader.validate(view)) {
+			return false;
+		}
+
+		for (const auto& item : staged) {
+			if (item.first.kind == PLANE_EXITED) {
+				planes.erase(item.first.id);
+			} else {
+				planes[item.first.id] = {item.second, view.timestamp};
+			}
+			changes.push_back(item.first);
+		}
+		frameNumber = view.frame_number;
+		timestamp = view.timestamp;
+	}
+	return true;
+}
+
+// Replaces the tracked planes with the newest full frame and records how that
+// differs from what was tracked before
+bool AirspaceTracker::rebuild(AirspaceReader& reader) {
+	while (true) {
+		FrameView view;
+		if (!reader.frameBack(0, view)) {
+			return false;
+		}
+
+		view.planes.copyTo(keyframe);
+		if (!reader.validate(view)) {
+			continue;
+		}
+
+		for (const auto& tracked : planes) {
+			auto it = std::lower_bound(keyframe.begin(), keyframe.end(), tracked.first,
+				[](const msg_plane_info& plane, int id) { return plane.id < id; });
+			if (it == keyframe.end() || it->id != tracked.first) {
+				changes.push_back({tracked.first, PLANE_EXITED});
+			}
+		}
+		for (const msg_plane_info& plane : keyframe) {
+			auto tracked = planes.find(plane.id);
+			if (tracked == planes.end()) {
+				changes.push_back({plane.id, PLANE_ENTERED});
+			} else if (planeChanged(tracked->second.info, plane)) {
+				changes.push_back({plane.id, PLANE_UPDATED});
+			}
+		}
+
+		planes.clear();
+		for (const msg_plane_info& plane : keyframe) {
+			planes[plane.id] = {plane, view.timestamp};
+		}
+		frameNumber = view.frame_number;
+		timestamp = view.timestamp;
+		generation = view.generation;
+		return true;
+	}
+}
+
+const std::vector<msg_plane_change>& AirspaceTracker::getChanges() const {
+	return changes;
+}
+
+bool AirspaceTracker::wasRebuilt() const {
+	return rebuilt;
+}
+
+uint64_t AirspaceTracker::getFrameNumber() const {
+	return frameNumber;
+}
+
+uint64_t AirspaceTracker::getTimestamp() const {
+	return timestamp;
+}
+
+const std::unordered_map<int, TrackedPlane>& AirspaceTracker::getPlanes() const {
+	return planes;
+}
+
+void AirspaceTracker::extrapolate(uint64_t at, std::vector<msg_plane_info>& out) const {
+	extrapolateInto(at, out);
+}
+
+void AirspaceTracker::extrapolate(uint64_t at, PlaneColumns& out) const {
+	extrapolateInto(at, out);
+}
+
+template <typename Out>
+void AirspaceTracker::extrapolateInto(uint64_t at, Out& out) const {
+	order.clear();
+	for (const auto& tracked : planes) {
+		order.push_back(&tracked.second);
+	}
+	std::sort(order.begin(), order.end(),
+		[](const TrackedPlane* a, const TrackedPlane* b) { return a->info.id < b->info.id; });
+
+	out.clear();
+	out.reserve(order.size());
+	for (const TrackedPlane* tracked : order) {
+		msg_plane_info plane = tracked->info;
+		double elapsed = (static_cast<double>(at) - static_cast<double>(tracked->reference_time)) / 1000.0;
+		plane.PositionX += plane.VelocityX * elapsed;
+		plane.PositionY += plane.VelocityY * elapsed;
+		plane.PositionZ += plane.VelocityZ * elapsed;
+		out.push_back(plane);
+	}
+}
+
+
+PlaneView::PlaneView() : count(0), columnar(false), base(), stride() {}
+
+PlaneView PlaneView::ofStructs(const msg_plane_info* planes, uint32_t count) {
+	PlaneView view;
+	view.count = count;
+	const char* first = reinterpret_cast<const char*>(planes);
+	view.base[COLUMN_ID] = first + offsetof(msg_plane_info, id);
+	view.base[COLUMN_FLAGS] = first + offsetof(msg_plane_info, flags);
+	view.base[COLUMN_X] = first + offsetof(msg_plane_info, PositionX);
+	view.base[COLUMN_Y] = first + offsetof(msg_plane_info, PositionY);
+	view.base[COLUMN_Z] = first + offsetof(msg_plane_info, PositionZ);
+	view.base[COLUMN_VX] = first + offsetof(msg_plane_info, VelocityX);
+	view.base[COLUMN_VY] = first + offsetof(msg_plane_info, VelocityY);
+	view.base[COLUMN_VZ] = first + offsetof(msg_plane_info, VelocityZ);
+	for (int column = 0; column < COLUMN_COUNT; ++column) {
+		view.stride[column] = sizeof(msg_plane_info);
+	}
+	return view;
+}
+
+PlaneView PlaneView::ofRegion(const char* region, uint32_t capacity, uint32_t count) {
+	return ofColumns(count,
+		reinterpret_cast<const int*>(region + soaColumnOffset(capacity, COLUMN_ID)),
+		reinterpret_cast<const int*>(region + soaColumnOffset(capacity, COLUMN_FLAGS)),
+		reinterpret_cast<const double*>(region + soaColumnOffset(capacity, COLUMN_X)),
+		reinterpret_cast<const double*>(region + soaColumnOffset(capacity, COLUMN_Y)),
+		reinterpret_cast<const double*>(region + soaColumnOffset(capacity, COLUMN_Z)),
+		reinterpret_cast<const double*>(region + soaColumnOffset(capacity, COLUMN_VX)),
+		reinterpret_cast<const double*>(region + soaColumnOffset(capacity, COLUMN_VY)),
+		reinterpret_cast<const double*>(region + soaColumnOffset(capacity, COLUMN_VZ)));
+}
+
+PlaneView PlaneView::ofColumns(uint32_t count, const int* id, const int* flags, const double* x, const double* y,
+							   const double* z, const double* vx, const double* vy, const double* vz) {
+	PlaneView view;
+	view.count = count;
+	view.columnar = true;
+	view.base[COLUMN_ID] = reinterpret_cast<const char*>(id);
+	view.base[COLUMN_FLAGS] = reinterpret_cast<const char*>(flags);
+	view.base[COLUMN_X] = reinterpret_cast<const char*>(x);
+	view.base[COLUMN_Y] = reinterpret_cast<const char*>(y);
+	view.base[COLUMN_Z] = reinterpret_cast<const char*>(z);
+	view.base[COLUMN_VX] = reinterpret_cast<const char*>(vx);
+	view.base[COLUMN_VY] = reinterpret_cast<const char*>(vy);
+	view.base[COLUMN_VZ] = reinterpret_cast<const char*>(vz);
+	view.stride[COLUMN_ID] = sizeof(int);
+	view.stride[COLUMN_FLAGS] = sizeof(int);
+	for (int column = COLUMN_X; column < COLUMN_COUNT; ++column) {
+		view.stride[column] = sizeof(double);
+	}
+	return view;
+}
+
+const double* PlaneView::column(PlaneColumn column) const {
+	return columnar ? reinterpret_cast<const double*>(base[column]) : nullptr;
+}
+
+const int* PlaneView::ids() const {
+	return columnar ? reinterpret_cast<const int*>(base[COLUMN_ID]) : nullptr;
+}
+
+msg_plane_info PlaneView::at(uint32_t i) const {
+	msg_plane_info plane = {id(i), flags(i), x(i), y(i), z(i), vx(i), vy(i), vz(i)};
+	return plane;
+}
+
+int PlaneView::find(int planeId) const {
+	uint32_t low = 0, high = count;
+	while (low < high) {
+		uint32_t mid = low + (high - low) / 2;
+		if (id(mid) < planeId) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+	return (low < count && id(low) == planeId) ? static_cast<int>(low) : -1;
+}
+
+void PlaneView::copyTo(std::vector<msg_plane_info>& planes) const {
+	if (!columnar && count) {
+		const msg_plane_info* first = reinterpret_cast<const msg_plane_info*>(base[COLUMN_ID] - offsetof(msg_plane_info, id));
+		planes.assign(first, first + count);
+		return;
+	}
+	planes.resize(count);
+	for (uint32_t i = 0; i < count; ++i) {
+		planes[i] = at(i);
+	}
+}
+
+
+void PlaneColumns::clear() {
+	id.clear();
+	flags.clear();
+	x.clear();
+	y.clear();
+	z.clear();
+	vx.clear();
+	vy.clear();
+	vz.clear();
+}
+
+void PlaneColumns::reserve(size_t count) {
+	id.reserve(count);
+	flags.reserve(count);
+	x.reserve(count);
+	y.reserve(count);
+	z.reserve(count);
+	vx.reserve(count);
+	vy.reserve(count);
+	vz.reserve(count);
+}
+
+void PlaneColumns::push_back(const msg_plane_info& plane) {
+	id.push_back(plane.id);
+	flags.push_back(plane.flags);
+	x.push_back(plane.PositionX);
+	y.push_back(plane.PositionY);
+	z.push_back(plane.PositionZ);
+	vx.push_back(plane.VelocityX);
+	vy.push_back(plane.VelocityY);
+	vz.push_back(plane.VelocityZ);
+}
+
+PlaneView PlaneColumns::view() const {
+	return PlaneView::ofColumns(size(), id.data(), flags.data(), x.data(), y.data(), z.data(), vx.data(), vy.data(), vz.data());
+}
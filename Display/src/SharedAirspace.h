@@ -0,0 +1,461 @@
+/*
+ * Shared memory segment the Radar publishes its frames into, and the
+ * ComputerSystem and Display read from.
+ *
+ * *****Layout*****:
+ * The segment starts with a SharedMemory header followed by a ring of
+ * `history_depth` frames. Each frame is a RadarFrame header followed by
+ * room for `capacity` planes, sorted by plane id, and for 2 * `capacity`
+ * msg_plane_change entries. The header carries the layout version, the
+ * capacity, the ring depth and the frame layout, so every process sizes its
+ * mapping from the segment itself instead of from a compile-time constant.
+ *
+ * Planes are stored either as msg_plane_info structs (FRAME_LAYOUT_AOS) or as
+ * separate id, flags, x, y, z, vx, vy, vz columns (FRAME_LAYOUT_SOA), chosen
+ * when the Radar starts. Frames and columns start on 64-byte boundaries.
+ * Readers go through PlaneView, which works over either layout.
+ *
+ * *****History ring*****:
+ * Sweep N is written into slot N % history_depth and `latest_frame` is then
+ * advanced to N. Readers can look at any of the last history_depth frames in
+ * place (frameBack) or walk one aircraft's recent samples (forEachSample).
+ * A frame k sweeps old is only overwritten after history_depth - 1 - k more
+ * sweeps, which is the time a reader has to finish with it.
+ *
+ * *****Deltas*****:
+ * Every frame also lists what changed since the frame before it: planes that
+ * entered, left, or changed velocity, staleness or maneuver count. Ordinary
+ * constant-velocity motion is not a change. Readers that follow the deltas
+ * (AirspaceTracker) only touch the planes in that list; every
+ * keyframe_interval frames the frame is flagged as a keyframe and they rebuild
+ * from the full array, which bounds any drift and lets late joiners sync. The
+ * full array is still written every sweep so history reads stay in place.
+ *
+ * *****Resizing*****:
+ * The Radar only ever grows the segment (ftruncate + remap) when a frame does
+ * not fit. Growing changes the frame stride, so the ring is reset and the
+ * header's generation is bumped; readers notice and remap on their next read,
+ * so they never need to be restarted.
+ *
+ * *****Notification*****:
+ * The header holds a process-shared mutex and condition variable. After every
+ * frame the Radar broadcasts on it if a reader is waiting, so readers block in
+ * waitForFrame() and wake as soon as the frame is published instead of
+ * polling on a timer of their own. Readers map the header read-write for
+ * this; the frames stay read-only to them. The mutex is robust, so a reader
+ * killed while holding it cannot stall the Radar's next broadcast.
+ *
+ * A Radar that starts never reuses a segment others may still be waiting on:
+ * it marks the old one retired, unlinks it and creates a fresh one under the
+ * same name. Readers notice the mark in waitForFrame() and switch over.
+ *
+ * *****Consistency*****:
+ * Every frame has its own sequence counter (seqlock), odd while the Radar is
+ * writing it. The header's generation is odd while the layout is changing.
+ * Readers take a FrameView, read it in place and then validate() it; nobody
+ * takes a lock.
+ */
+
+#ifndef SHAREDAIRSPACE_H_
+#define SHAREDAIRSPACE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <pthread.h>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "Msg_structs.h"
+
+// Shared memory name (same in Radar, ComputerSystem and Display)
+#define AIRSPACE_SHM_NAME "/tmp/AH_40247851_40228573_Radar_shm"
+
+// Bump whenever the header, frame or plane entry layout changes
+const uint32_t AIRSPACE_LAYOUT_VERSION = 8;
+
+// Number of plane slots per frame the Radar maps on start-up; the segment grows past this on demand
+const uint32_t AIRSPACE_INITIAL_CAPACITY = 128;
+
+// Number of sweeps kept in the ring unless the Radar is told otherwise
+const uint32_t AIRSPACE_DEFAULT_HISTORY_DEPTH = 8;
+
+// Alignment of every frame and SoA column in the segment
+const size_t AIRSPACE_ALIGNMENT = 64;
+
+// SharedMemory::frame_layout
+const uint32_t FRAME_LAYOUT_AOS = 0;	// Planes as msg_plane_info structs
+const uint32_t FRAME_LAYOUT_SOA = 1;	// Planes as one contiguous column per field
+
+// Frames between two keyframes unless the Radar is told otherwise
+const uint32_t AIRSPACE_DEFAULT_KEYFRAME_INTERVAL = 30;
+
+// Segment header, followed in memory by history_depth frames
+struct SharedMemory {
+	uint32_t layout_version;				// AIRSPACE_LAYOUT_VERSION once the Radar has initialized the segment
+	std::atomic<uint32_t> generation;		// Odd while the Radar resizes or resets the ring
+	std::atomic<uint32_t> capacity;			// Plane slots per frame
+	std::atomic<uint32_t> history_depth;	// Frames kept in the ring
+	std::atomic<uint32_t> frame_layout;		// FRAME_LAYOUT_*
+	std::atomic<uint64_t> latest_frame;		// Number of the newest complete frame, 0 before the first sweep
+	std::atomic<bool> is_empty;				// Flag to indicate if there are no planes in the newest frame
+	bool start;
+	std::atomic<uint32_t> waiters;			// Readers blocked in waitForFrame
+	std::atomic<bool> retired;				// Set when a restarted Radar has replaced the segment
+	pthread_mutex_t frame_mutex;			// Process-shared and robust; only guards the wait on frame_ready
+	pthread_cond_t frame_ready;				// Broadcast when latest_frame changes
+};
+
+// RadarFrame::flags
+const uint32_t FRAME_KEYFRAME = 0x1;	// Readers should rebuild from the full array rather than apply the changes
+
+// msg_plane_change::kind
+enum PlaneChangeKind {
+	PLANE_ENTERED = 0,
+	PLANE_EXITED = 1,
+	PLANE_UPDATED = 2
+};
+
+// One entry of a frame's change list
+typedef struct {
+	int id;
+	int kind;	// PlaneChangeKind
+} msg_plane_change;
+
+// One sweep, followed in memory by the planes (in the segment's frame layout)
+// and msg_plane_change changes[2 * capacity]
+struct RadarFrame {
+	std::atomic<uint32_t> sequence;		// Seqlock counter: odd while the radar is writing this frame
+	uint32_t count;						// Number of planes in this frame
+	uint64_t frame_number;				// Sweep number, 0 if the slot has not been written since the last reset
+	uint64_t timestamp;					// Simulation time of the sweep in ms
+	uint32_t change_count;				// Number of entries in the change list
+	uint32_t flags;						// FRAME_* bits
+};
+
+// True if `current` differs from `previous` by more than constant-velocity motion
+inline bool planeChanged(const msg_plane_info& previous, const msg_plane_info& current) {
+	return previous.VelocityX != current.VelocityX || previous.VelocityY != current.VelocityY
+		|| previous.VelocityZ != current.VelocityZ || previous.flags != current.flags;
+}
+
+// Plane fields, in the order of the SoA columns
+enum PlaneColumn {
+	COLUMN_ID,
+	COLUMN_FLAGS,
+	COLUMN_X,
+	COLUMN_Y,
+	COLUMN_Z,
+	COLUMN_VX,
+	COLUMN_VY,
+	COLUMN_VZ,
+	COLUMN_COUNT
+};
+
+// Round a size up to the alignment of frames and SoA columns
+inline size_t alignUp(size_t size) {
+	return (size + AIRSPACE_ALIGNMENT - 1) & ~(AIRSPACE_ALIGNMENT - 1);
+}
+
+// Offset of a column from the start of an SoA plane region: the two int
+// columns first, then the six double columns, each padded to the alignment
+inline size_t soaColumnOffset(uint32_t capacity, PlaneColumn column) {
+	size_t intColumn = alignUp(static_cast<size_t>(capacity) * sizeof(int));
+	size_t doubleColumn = alignUp(static_cast<size_t>(capacity) * sizeof(double));
+	if (column <= COLUMN_FLAGS) {
+		return column * intColumn;
+	}
+	return 2 * intColumn + (column - COLUMN_X) * doubleColumn;
+}
+
+// Size in bytes of the planes of one frame
+inline size_t planeRegionSize(uint32_t capacity, uint32_t layout) {
+	if (layout == FRAME_LAYOUT_SOA) {
+		return soaColumnOffset(capacity, COLUMN_COUNT);
+	}
+	return alignUp(static_cast<size_t>(capacity) * sizeof(msg_plane_info));
+}
+
+// Size in bytes of one frame slot holding `capacity` planes
+inline size_t frameStride(uint32_t capacity, uint32_t layout) {
+	return alignUp(sizeof(RadarFrame)) + planeRegionSize(capacity, layout)
+		+ alignUp(2 * static_cast<size_t>(capacity) * sizeof(msg_plane_change));
+}
+
+// Size in bytes of a segment holding `depth` frames of `capacity` planes
+inline size_t sharedMemorySize(uint32_t capacity, uint32_t depth, uint32_t layout) {
+	return alignUp(sizeof(SharedMemory)) + static_cast<size_t>(depth) * frameStride(capacity, layout);
+}
+
+// Frame slot `index` of the ring
+inline RadarFrame* frameAt(SharedMemory* shared_mem, uint32_t capacity, uint32_t layout, uint32_t index) {
+	return reinterpret_cast<RadarFrame*>(reinterpret_cast<char*>(shared_mem) + alignUp(sizeof(SharedMemory))
+		+ index * frameStride(capacity, layout));
+}
+inline const RadarFrame* frameAt(const SharedMemory* shared_mem, uint32_t capacity, uint32_t layout, uint32_t index) {
+	return reinterpret_cast<const RadarFrame*>(reinterpret_cast<const char*>(shared_mem) + alignUp(sizeof(SharedMemory))
+		+ index * frameStride(capacity, layout));
+}
+
+// Start of the planes that follow a frame header
+inline char* planeRegion(RadarFrame* frame) {
+	return reinterpret_cast<char*>(frame) + alignUp(sizeof(RadarFrame));
+}
+inline const char* planeRegion(const RadarFrame* frame) {
+	return reinterpret_cast<const char*>(frame) + alignUp(sizeof(RadarFrame));
+}
+
+// Start of the change list that follows a frame's planes
+inline msg_plane_change* changeData(RadarFrame* frame, uint32_t capacity, uint32_t layout) {
+	return reinterpret_cast<msg_plane_change*>(planeRegion(frame) + planeRegionSize(capacity, layout));
+}
+inline const msg_plane_change* changeData(const RadarFrame* frame, uint32_t capacity, uint32_t layout) {
+	return reinterpret_cast<const msg_plane_change*>(planeRegion(frame) + planeRegionSize(capacity, layout));
+}
+
+// Read access to planes stored either as msg_plane_info structs or as one
+// column per field. Every field is a base pointer plus a byte stride, so the
+// accessors are the same for both layouts; kernels that want contiguous data
+// ask for column() and fall back to the accessors when it returns nullptr.
+class PlaneView {
+public:
+	PlaneView();
+
+	static PlaneView ofStructs(const msg_plane_info* planes, uint32_t count);
+	// An SoA plane region as laid out in a frame of `capacity` planes
+	static PlaneView ofRegion(const char* region, uint32_t capacity, uint32_t count);
+	static PlaneView ofColumns(uint32_t count, const int* id, const int* flags, const double* x, const double* y,
+							   const double* z, const double* vx, const double* vy, const double* vz);
+
+	uint32_t size() const { return count; }
+	bool isColumnar() const { return columnar; }
+
+	int id(uint32_t i) const { return *reinterpret_cast<const int*>(base[COLUMN_ID] + i * stride[COLUMN_ID]); }
+	int flags(uint32_t i) const { return *reinterpret_cast<const int*>(base[COLUMN_FLAGS] + i * stride[COLUMN_FLAGS]); }
+	double value(PlaneColumn column, uint32_t i) const {
+		return *reinterpret_cast<const double*>(base[column] + i * stride[column]);
+	}
+	double x(uint32_t i) const { return value(COLUMN_X, i); }
+	double y(uint32_t i) const { return value(COLUMN_Y, i); }
+	double z(uint32_t i) const { return value(COLUMN_Z, i); }
+	double vx(uint32_t i) const { return value(COLUMN_VX, i); }
+	double vy(uint32_t i) const { return value(COLUMN_VY, i); }
+	double vz(uint32_t i) const { return value(COLUMN_VZ, i); }
+
+	// Contiguous column of a double field, or nullptr if the view is over structs
+	const double* column(PlaneColumn column) const;
+	// Contiguous id column, or nullptr if the view is over structs
+	const int* ids() const;
+
+	msg_plane_info at(uint32_t i) const;
+	// Index of `planeId` (planes are sorted by id), or -1
+	int find(int planeId) const;
+	void copyTo(std::vector<msg_plane_info>& planes) const;
+
+private:
+	uint32_t count;
+	bool columnar;
+	const char* base[COLUMN_COUNT];
+	size_t stride[COLUMN_COUNT];
+};
+
+// Reader-owned planes in SoA form
+struct PlaneColumns {
+	std::vector<int> id, flags;
+	std::vector<double> x, y, z, vx, vy, vz;
+
+	void clear();
+	void reserve(size_t count);
+	void push_back(const msg_plane_info& plane);
+	size_t size() const { return id.size(); }
+	PlaneView view() const;
+};
+
+// A frame read in place. Only trust what was read through it once validate() says so.
+struct FrameView {
+	uint64_t frame_number;
+	uint64_t timestamp;
+	uint32_t count;
+	PlaneView planes;
+	uint32_t flags;
+	uint32_t change_count;
+	const msg_plane_change* changes;	// Changes since frame_number - 1
+
+	const RadarFrame* frame;		// Slot the view points into
+	uint32_t sequence;				// Slot sequence when the view was taken
+	uint32_t generation;			// Segment generation when the view was taken
+};
+
+// Radar side: owns the segment and publishes frames into it
+class AirspaceWriter {
+public:
+	AirspaceWriter();
+	~AirspaceWriter();
+
+	// Retire any segment left by an earlier Radar and create and map a fresh one
+	bool open(uint32_t initialCapacity = AIRSPACE_INITIAL_CAPACITY, uint32_t historyDepth = AIRSPACE_DEFAULT_HISTORY_DEPTH,
+			  uint32_t keyframeInterval = AIRSPACE_DEFAULT_KEYFRAME_INTERVAL, uint32_t frameLayout = FRAME_LAYOUT_AOS);
+	void close();
+
+	// Publish one frame (planes sorted by id), growing the segment first if it does not fit
+	void publish(const std::vector<msg_plane_info>& planes, uint64_t timestamp);
+
+	// Drop the history and mark the airspace empty
+	void clear();
+
+	uint32_t getCapacity() const;
+	uint32_t getHistoryDepth() const;
+	uint32_t getFrameLayout() const;
+
+private:
+	bool resize(uint32_t capacity, uint32_t depth);
+	uint32_t retirePrevious();
+	void writePlanes(RadarFrame* frame, const std::vector<msg_plane_info>& planes, size_t count);
+	void resetRing();
+	void notifyReaders();
+	uint32_t diff(const msg_plane_info* planes, size_t count, msg_plane_change* changes) const;
+
+	int shm_fd;
+	SharedMemory* shared_mem;
+	uint32_t mappedCapacity;
+	uint32_t mappedDepth;
+	uint32_t frameLayout;
+	uint64_t nextFrame;
+	uint32_t keyframeInterval;
+	uint32_t framesSinceKeyframe;
+	bool keyframePending;						// Set when readers can no longer follow the deltas (reset, resize)
+	std::vector<msg_plane_info> previousFrame;	// Last published planes, the base for the next change list
+};
+
+// ComputerSystem / Display side: maps the segment read-only and reads frames in place
+class AirspaceReader {
+public:
+	AirspaceReader();
+	~AirspaceReader();
+
+	// Single attempt to map the segment; fails until the Radar has initialized it
+	bool open();
+	void close();
+
+	// View of the frame k sweeps before the newest (k = 0 is the newest).
+	// Returns false if that frame has not been published or has already been overwritten.
+	bool frameBack(uint32_t k, FrameView& view);
+
+	// View of frame `number`; false if it is not published yet or no longer in the ring
+	bool frameNumbered(uint64_t number, FrameView& view);
+
+	// True if the frame behind the view was not rewritten while it was being read
+	bool validate(const FrameView& view) const;
+
+
+	// Calls fn(view, sample) for `planeId` in each of the last `frames` frames, newest
+	// first, stopping at the first frame that is missing or was overwritten.
+	// Returns the number of samples visited.
+	template <typename Fn>
+	size_t forEachSample(int planeId, uint32_t frames, Fn fn);
+
+	// Block until the newest frame number differs from `after` or `timeoutMs` passes.
+	// Returns the newest frame number (`after` on timeout). Switches to the segment
+	// of a restarted Radar first, if there is one.
+	uint64_t waitForFrame(uint64_t after, uint32_t timeoutMs);
+
+	// Copy the newest frame; returns false if the airspace is empty
+	bool readSnapshot(std::vector<msg_plane_info>& planes, uint64_t& timestamp);
+
+	bool isEmpty() const;
+	uint64_t getTimestamp();
+	uint32_t getCapacity() const;
+	uint32_t getHistoryDepth() const;
+	uint32_t getFrameLayout() const;
+
+private:
+	bool findFrame(uint32_t k, uint64_t wanted, FrameView& view);
+	bool remap(uint32_t capacity, uint32_t depth, uint32_t layout);
+	bool refreshMapping();
+	bool reopen();
+
+	int shm_fd;
+	const SharedMemory* shared_mem;
+	SharedMemory* notify_mem;			// Writable mapping of just the header, for waitForFrame
+	uint32_t mappedCapacity;
+	uint32_t mappedDepth;
+	uint32_t mappedLayout;
+	uint32_t mappedGeneration;
+};
+
+// A plane as last reported by the deltas
+struct TrackedPlane {
+	msg_plane_info info;		// State when the plane last entered or changed
+	uint64_t reference_time;	// Timestamp (ms) of the frame `info` was taken from
+};
+
+// Reader-side copy of the airspace, kept current from the frame change lists.
+// Unchanged planes are not copied again; their position is extrapolated from
+// the reference state along their (unchanged) velocity.
+class AirspaceTracker {
+public:
+	AirspaceTracker();
+
+	// Bring the tracked planes up to the newest frame, applying every missed frame's
+	// changes that is still in the ring, or rebuilding from the newest frame on a
+	// keyframe, a reset or a gap. Returns false if there was no new frame.
+	bool update(AirspaceReader& reader);
+
+	// What the last update changed, in order; a rebuild contributes the difference
+	// from the planes tracked before it
+	const std::vector<msg_plane_change>& getChanges() const;
+	bool wasRebuilt() const;
+
+	uint64_t getFrameNumber() const;
+	uint64_t getTimestamp() const;
+	const std::unordered_map<int, TrackedPlane>& getPlanes() const;
+
+	// Every tracked plane moved along its velocity (per second) to `timestamp` (ms), sorted by id
+	void extrapolate(uint64_t timestamp, std::vector<msg_plane_info>& planes) const;
+	void extrapolate(uint64_t timestamp, PlaneColumns& planes) const;
+
+private:
+	template <typename Out>
+	void extrapolateInto(uint64_t timestamp, Out& planes) const;
+
+	bool applyDeltas(AirspaceReader& reader, uint64_t latest);
+	bool rebuild(AirspaceReader& reader);
+
+	std::unordered_map<int, TrackedPlane> planes;
+	std::vector<msg_plane_change> changes;
+	std::vector<std::pair<msg_plane_change, msg_plane_info>> staged;	// Changes read from a frame before it validated
+	std::vector<msg_plane_info> keyframe;								// Full frame read by rebuild()
+	mutable std::vector<const TrackedPlane*> order;						// Scratch for extrapolate()
+	uint64_t frameNumber;
+	uint64_t timestamp;
+	uint32_t generation;
+	bool rebuilt;
+};
+
+template <typename Fn>
+size_t AirspaceReader::forEachSample(int planeId, uint32_t frames, Fn fn) {
+	size_t visited = 0;
+	for (uint32_t k = 0; k < frames; ++k) {
+		FrameView view;
+		if (!frameBack(k, view)) {
+			break;
+		}
+
+		// Copy the single entry so fn never sees a sample that fails validation
+		int index = view.planes.find(planeId);
+		msg_plane_info copy;
+		if (index >= 0) {
+			copy = view.planes.at(index);
+		}
+		if (!validate(view)) {
+			break;
+		}
+		if (index >= 0) {
+			fn(view, copy);
+			++visited;
+		}
+	}
+	return visited;
+}
+
+#endif /* SHAREDAIRSPACE_H_ */
@@ -6,12 +6,39 @@
 Display* g_display = nullptr;
 
 
-int main() {
+int main(int argc, char* argv[]) {
 
     std::cout << "ATC Display System Starting\n\n\n";
 
+    // Optional settings: --refresh-ms <ms> (0, the default, redraws on every radar frame)
+    // and --clock realtime|virtual (virtual follows the simulation's --clock scaled|lockstep)
+    uint32_t refreshPeriodMs = 0;
+    bool followClock = false;
+    for (int i = 1; i < argc; i += 2) {
+        std::string option = argv[i];
+        // A trailing option without its value is as wrong as an unknown one
+        if (i + 1 == argc) {
+            std::cerr << "Unknown option: " << option << " (no value)" << std::endl;
+            return EXIT_FAILURE;
+        }
+        if (option == "--refresh-ms") {
+            refreshPeriodMs = std::stoul(argv[i + 1]);
+        } else if (option == "--clock") {
+            std::string clock = argv[i + 1];
+            if (clock == "realtime" || clock == "virtual") {
+                followClock = (clock == "virtual");
+            } else {
+                std::cerr << "Unknown clock: " << clock << std::endl;
+                return EXIT_FAILURE;
+            }
+        } else {
+            std::cerr << "Unknown option: " << option << " " << argv[i + 1] << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
     // Create Display instance
-    Display display;
+    Display display(refreshPeriodMs, followClock);
     g_display = &display;
 
     // Initialize the display system